@@ -1,10 +1,12 @@
 #include "devices/kbd.h"
 #include <ctype.h>
 #include <debug.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "devices/input.h"
 #include "devices/shutdown.h"
+#include "threads/defer.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 
@@ -25,6 +27,7 @@ static bool caps_lock;
 static int64_t key_cnt;
 
 static intr_handler_func keyboard_interrupt;
+static defer_func process_scancode;
 
 /* Initializes the keyboard. */
 void
@@ -94,6 +97,23 @@ static bool map_key (const struct keymap[], unsigned scancode, uint8_t *);
 
 static void
 keyboard_interrupt (struct intr_frame *args UNUSED) 
+{
+  /* Keyboard scancode. */
+  unsigned code;
+
+  /* Read scancode, including second byte if prefix code, and
+     leave translating it to a worker thread. */
+  code = inb (DATA_REG);
+  if (code == 0xe0)
+    code = (code << 8) | inb (DATA_REG);
+  defer_work (process_scancode, (void *) (uintptr_t) code);
+}
+
+/* Translates keyboard scancode CODE_ into a key, updating the
+   shift state, and appends the key to the input buffer.  Runs
+   as deferred work queued by keyboard_interrupt(). */
+static void
+process_scancode (void *code_) 
 {
   /* Status of shift keys. */
   bool shift = left_shift || right_shift;
@@ -101,7 +121,7 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
   bool ctrl = left_ctrl || right_ctrl;
 
   /* Keyboard scancode. */
-  unsigned code;
+  unsigned code = (uintptr_t) code_;
 
   /* False if key pressed, true if key released. */
   bool release;
@@ -109,10 +129,8 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
   /* Character that corresponds to `code'. */
   uint8_t c;
 
-  /* Read scancode, including second byte if prefix code. */
-  code = inb (DATA_REG);
-  if (code == 0xe0)
-    code = (code << 8) | inb (DATA_REG);
+  /* Saved interrupt level while appending to the input buffer. */
+  enum intr_level old_level;
 
   /* Bit 0x80 distinguishes key press from key release
      (even if there's a prefix). */
@@ -154,11 +172,13 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
             c += 0x80;
 
           /* Append to keyboard buffer. */
+          old_level = intr_disable ();
           if (!input_full ())
             {
               key_cnt++;
               input_putc (c);
             }
+          intr_set_level (old_level);
         }
     }
   else
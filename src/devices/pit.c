@@ -1,5 +1,6 @@
 #include "devices/pit.h"
 #include <debug.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
@@ -11,9 +12,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +79,74 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts the given CHANNEL counting down once from COUNT PIT
+   cycles in mode 0, "interrupt on terminal count".  For channel
+   0, this raises a single timer interrupt COUNT cycles from now,
+   after which the channel stays quiet until reprogrammed.  COUNT
+   must be nonzero. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (count != 0);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current value of CHANNEL's down-counter, using the
+   counter latch command so that both bytes come from the same
+   instant.  In mode 0, the counter keeps decrementing past zero,
+   wrapping around to PIT_COUNT_MAX. */
+uint16_t
+pit_read_count (int channel)
+{
+  enum intr_level old_level;
+  uint16_t count;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, channel << 6);
+  count = inb (PIT_PORT_COUNTER (channel));
+  count |= inb (PIT_PORT_COUNTER (channel)) << 8;
+  intr_set_level (old_level);
+  return count;
+}
+
+/* Returns the state of CHANNEL's output, using the read-back
+   command, and if COUNTP is non-null stores into *COUNTP the
+   value of CHANNEL's down-counter at the same instant.  In mode
+   0, the output goes high when the count runs out and stays high
+   until the channel is reprogrammed, so it tells reliably
+   whether a one-shot has expired, however long ago. */
+bool
+pit_read_output (int channel, uint16_t *countp)
+{
+  enum intr_level old_level;
+  uint8_t status;
+  uint16_t count;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  /* Read-back command: latch status, and count if wanted, for
+     CHANNEL alone.  The status byte is read first. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL,
+        0xc0 | (countp == NULL ? 0x20 : 0) | (2 << channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  if (countp != NULL)
+    {
+      count = inb (PIT_PORT_COUNTER (channel));
+      count |= inb (PIT_PORT_COUNTER (channel)) << 8;
+      *countp = count;
+    }
+  intr_set_level (old_level);
+  return (status & 0x80) != 0;
+}
@@ -1,8 +1,18 @@
 #ifndef DEVICES_PIT_H
 #define DEVICES_PIT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/* PIT cycles per second. */
+#define PIT_HZ 1193180
+
+/* Largest count the PIT's 16-bit counters can be loaded with. */
+#define PIT_COUNT_MAX 0xffff
+
 void pit_configure_channel (int channel, int mode, int frequency);
+void pit_start_oneshot (int channel, uint16_t count);
+uint16_t pit_read_count (int channel);
+bool pit_read_output (int channel, uint16_t *countp);
 
 #endif /* devices/pit.h */
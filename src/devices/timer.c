@@ -1,6 +1,7 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
@@ -20,11 +21,55 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Threads blocked in timer_sleep() or in a wait with a timeout,
+   in ascending order of wake_tick.  Drained from the front by
+   timer_interrupt(). */
+static struct list sleep_list;
+
+/* If true, the timer interrupt is stopped while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Tickless idle.
+
+   Normally the PIT raises an interrupt every TICK_CYCLES cycles.
+   When the idle thread is about to halt and no sleeper is due on
+   the next tick, timer_enter_idle() instead starts a one-shot
+   count that ends exactly on a later tick boundary, the first
+   sleeper's wake-up tick or TICKLESS_MAX_TICKS away, whichever is
+   sooner.  The 16-bit PIT counter limits how far that can be.
+
+   If the one-shot expires, timer_interrupt() accounts for all of
+   the ticks it covered and resumes periodic mode.  If another
+   interrupt makes a thread runnable first, timer_leave_idle()
+   accounts for the tick boundaries passed so far and starts a
+   second one-shot that ends on the next boundary, where periodic
+   mode resumes in step with the old tick phase.  Whether the
+   one-shot has expired is read back from the channel's output,
+   because its count wraps around and keeps going after it runs
+   out. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define TICKLESS_MAX_TICKS (PIT_COUNT_MAX / TICK_CYCLES)
+
+enum tick_mode
+  {
+    TICK_PERIODIC,              /* Interrupt on every tick. */
+    TICK_ONESHOT,               /* Idle, waiting for one-shot expiry. */
+    TICK_REALIGN                /* Waiting for the next tick boundary. */
+  };
+static enum tick_mode tick_mode;
+static unsigned oneshot_ticks;  /* Tick boundaries covered by one-shot. */
+static long long skipped_ticks; /* # of ticks without an interrupt. */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static bool wake_tick_less (const struct list_elem *,
+                            const struct list_elem *, void *aux);
+static void wake_sleepers (void);
+static void advance_ticks (unsigned cnt);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -35,6 +80,7 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
+  list_init (&sleep_list);
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -85,15 +131,59 @@ timer_elapsed (int64_t then)
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The calling thread is blocked on sleep_list until
+   timer_interrupt() finds its wake-up tick has arrived, so it
+   costs nothing while asleep. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  t->wake_tick = timer_ticks () + ticks;
+  list_insert_ordered (&sleep_list, &t->sleep_elem, wake_tick_less, NULL);
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Arranges for blocked thread T to be woken at tick WAKE_TICK
+   unless timer_cancel_timeout() is called first.  T must be
+   about to block with its `elem' on a wait list, such as a
+   semaphore's; on timeout, T is removed from that list, its
+   timed_out member is set to true, and it is unblocked.
+   Interrupts must be off. */
+void
+timer_arm_timeout (struct thread *t, int64_t wake_tick)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!t->timed_wait);
+
+  t->wake_tick = wake_tick;
+  t->timed_wait = true;
+  t->timed_out = false;
+  list_insert_ordered (&sleep_list, &t->sleep_elem, wake_tick_less, NULL);
+}
+
+/* Cancels the timeout armed for T by timer_arm_timeout(), if it
+   has not yet expired.  Called when T is woken some other way.
+   Interrupts must be off. */
+void
+timer_cancel_timeout (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->timed_wait)
+    {
+      list_remove (&t->sleep_elem);
+      t->timed_wait = false;
+    }
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -159,19 +249,152 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, replaces the periodic timer
+   interrupt by a one-shot interrupt at the next tick on which
+   there is work to do. */
+void
+timer_enter_idle (void)
+{
+  int64_t idle_ticks = TICKLESS_MAX_TICKS;
+  uint16_t first;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || tick_mode != TICK_PERIODIC)
+    return;
+  if (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, sleep_elem);
+      if (t->wake_tick - ticks < idle_ticks)
+        idle_ticks = t->wake_tick - ticks;
+    }
+  if (idle_ticks < 2)
+    return;
+
+  /* In periodic mode the counter holds the number of cycles left
+     until the next tick. */
+  first = pit_read_count (0);
+  if (first == 0 || first > TICK_CYCLES)
+    return;
+
+  oneshot_ticks = idle_ticks;
+  pit_start_oneshot (0, first + (idle_ticks - 1) * TICK_CYCLES);
+  tick_mode = TICK_ONESHOT;
+}
+
+/* Called from an interrupt handler that has made a thread
+   runnable while the CPU was idle.  If the timer is in a
+   tickless one-shot, catches up on the ticks that have passed
+   and arranges for periodic interrupts to resume at the next
+   tick boundary. */
+void
+timer_leave_idle (void)
+{
+  uint16_t remaining;
+  unsigned pending;
+
+  ASSERT (intr_context ());
+
+  if (tick_mode != TICK_ONESHOT)
+    return;
+
+  /* If the one-shot has already run out, its interrupt is
+     pending and timer_interrupt() will do the catching up. */
+  if (pit_read_output (0, &remaining) || remaining == 0)
+    return;
+
+  pending = DIV_ROUND_UP (remaining, TICK_CYCLES);
+  tick_mode = TICK_REALIGN;
+  pit_start_oneshot (0, remaining - (pending - 1) * TICK_CYCLES);
+  skipped_ticks += oneshot_ticks - pending;
+  advance_ticks (oneshot_ticks - pending);
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %lld ticks without an interrupt\n", skipped_ticks);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  thread_tick ();
+  if (tick_mode == TICK_ONESHOT)
+    {
+      /* In mode 0 the channel's output goes high when the count
+         runs out.  If it is still low, this is a periodic tick
+         that was already pending when the one-shot started, and
+         the one-shot's ticks all still lie ahead. */
+      if (pit_read_output (0, NULL))
+        {
+          tick_mode = TICK_PERIODIC;
+          pit_configure_channel (0, 2, TIMER_FREQ);
+          skipped_ticks += oneshot_ticks - 1;
+          advance_ticks (oneshot_ticks);
+          return;
+        }
+    }
+  else if (tick_mode == TICK_REALIGN)
+    {
+      tick_mode = TICK_PERIODIC;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+  advance_ticks (1);
+}
+
+/* Advances the tick count by CNT ticks, doing the work of a
+   timer interrupt for each one. */
+static void
+advance_ticks (unsigned cnt)
+{
+  while (cnt-- > 0)
+    {
+      ticks++;
+      wake_sleepers ();
+      thread_tick ();
+    }
+}
+
+/* Unblocks every thread on sleep_list whose wake-up tick has
+   arrived, first taking threads whose timeout expired off the
+   list they were waiting on.  Because the list is sorted, this
+   stops at the first thread that must keep sleeping. */
+static void
+wake_sleepers (void)
+{
+  while (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, sleep_elem);
+      if (t->wake_tick > ticks)
+        break;
+      list_pop_front (&sleep_list);
+      if (t->timed_wait)
+        {
+          list_remove (&t->elem);
+          t->timed_wait = false;
+          t->timed_out = true;
+        }
+      thread_unblock (t);
+    }
+}
+
+/* Orders threads on sleep_list by ascending wake_tick.  Threads
+   with equal wake ticks keep their insertion order. */
+static bool
+wake_tick_less (const struct list_elem *a_, const struct list_elem *b_,
+                void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, sleep_elem);
+  const struct thread *b = list_entry (b_, struct thread, sleep_elem);
+
+  return a->wake_tick < b->wake_tick;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -2,11 +2,18 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+struct thread;
+
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If true, the timer interrupt is stopped while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
 
@@ -24,6 +31,14 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* Timeouts for blocking waits. */
+void timer_arm_timeout (struct thread *, int64_t wake_tick);
+void timer_cancel_timeout (struct thread *);
+
+/* Tickless idle. */
+void timer_enter_idle (void);
+void timer_leave_idle (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
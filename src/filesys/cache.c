@@ -0,0 +1,418 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Buffer cache.
+
+   All file system I/O goes through a fixed set of CACHE_SIZE
+   sector buffers.  A sector that is read stays cached until the
+   clock algorithm reclaims its buffer, and a sector that is
+   written is only marked dirty.  Dirty sectors reach the disk
+   when a background thread flushes the cache every
+   FLUSH_INTERVAL ticks, when their buffer is reclaimed, and at
+   filesys_done().  Another background thread reads ahead the
+   sectors that cache_read_ahead() asks for, so that a process
+   reading a file sequentially finds its next sector cached.
+
+   CACHE_LOCK protects the assignment of sectors to buffers, the
+   clock hand and each buffer's PIN_CNT and ACCESSED.  A buffer's
+   own lock protects its data, VALID and DIRTY, and is held while
+   the buffer is read or written.  A buffer is pinned before its
+   lock is acquired, and only an unpinned buffer, whose lock is
+   therefore free, is given to a new sector.  CACHE_LOCK is never
+   held while waiting for a buffer's lock. */
+
+/* Number of sectors in the cache. */
+#define CACHE_SIZE 64
+
+/* Ticks between flushes of dirty sectors. */
+#define FLUSH_INTERVAL (2 * TIMER_FREQ)
+
+/* Number of read-ahead requests that can be queued.  Must be a
+   power of 2. */
+#define AHEAD_SIZE 16
+
+/* A sector buffer. */
+struct buffer
+  {
+    block_sector_t sector;      /* Sector held, or INVALID_SECTOR. */
+    unsigned pin_cnt;           /* Number of threads using the buffer. */
+    bool accessed;              /* Used since the clock hand passed? */
+
+    struct lock lock;           /* Protects the following members. */
+    bool valid;                 /* DATA holds SECTOR's contents? */
+    bool dirty;                 /* DATA newer than the disk? */
+    uint8_t *data;              /* BLOCK_SECTOR_SIZE bytes. */
+  };
+
+/* Sector number of an unused buffer. */
+#define INVALID_SECTOR ((block_sector_t) -1)
+
+static struct buffer buffers[CACHE_SIZE];
+static size_t hand;                     /* Clock hand. */
+static struct lock cache_lock;
+
+/* Read-ahead requests, a ring buffer protected by AHEAD_LOCK. */
+static block_sector_t ahead[AHEAD_SIZE];
+static unsigned ahead_head, ahead_tail;
+static struct lock ahead_lock;
+static struct semaphore ahead_avail;
+
+/* Set by cache_stop().  The background threads do no more I/O
+   once it is true. */
+static volatile bool stopped;
+
+/* Statistics. */
+static long long hit_cnt;               /* Sectors found cached. */
+static long long miss_cnt;              /* Sectors read from disk. */
+static long long ahead_cnt;             /* Sectors read ahead. */
+static long long writeback_cnt;         /* Sectors written to disk. */
+
+static struct buffer *buffer_get (block_sector_t, bool need_data);
+static void buffer_put (struct buffer *);
+static struct buffer *buffer_find (block_sector_t);
+static struct buffer *buffer_evict (void);
+static void buffer_flush (struct buffer *);
+static void flush_all (bool background);
+static thread_func flush_daemon;
+static thread_func ahead_daemon;
+
+/* Initializes the buffer cache and starts its background
+   threads. */
+void
+cache_init (void)
+{
+  size_t page_cnt = DIV_ROUND_UP (CACHE_SIZE * BLOCK_SECTOR_SIZE, PGSIZE);
+  uint8_t *data = palloc_get_multiple (PAL_ASSERT, page_cnt);
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct buffer *b = &buffers[i];
+
+      b->sector = INVALID_SECTOR;
+      b->pin_cnt = 0;
+      b->accessed = false;
+      lock_init (&b->lock);
+      b->valid = b->dirty = false;
+      b->data = data + i * BLOCK_SECTOR_SIZE;
+    }
+  hand = 0;
+  lock_init (&cache_lock);
+
+  ahead_head = ahead_tail = 0;
+  lock_init (&ahead_lock);
+  sema_init (&ahead_avail, 0);
+  stopped = false;
+
+  thread_create ("cache-flush", PRI_DEFAULT, flush_daemon, NULL);
+  thread_create ("cache-ahead", PRI_DEFAULT, ahead_daemon, NULL);
+}
+
+/* Reads SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Reads SIZE bytes starting at offset OFS within SECTOR into
+   BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, off_t ofs, size_t size)
+{
+  struct buffer *b;
+
+  ASSERT (ofs >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  b = buffer_get (sector, true);
+  memcpy (buffer, b->data + ofs, size);
+  buffer_put (b);
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER to SECTOR.  The
+   write reaches the disk later. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR starting at offset
+   OFS.  The write reaches the disk later.  The rest of the
+   sector is read from disk first unless the whole sector is
+   written. */
+void
+cache_write_at (block_sector_t sector, const void *buffer,
+                off_t ofs, size_t size)
+{
+  struct buffer *b;
+
+  ASSERT (ofs >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  b = buffer_get (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (b->data + ofs, buffer, size);
+  b->valid = true;
+  b->dirty = true;
+  buffer_put (b);
+}
+
+/* Asks for SECTOR to be read into the cache in the background,
+   in expectation that it will be read soon.  The request is
+   dropped if too many are already queued. */
+void
+cache_read_ahead (block_sector_t sector)
+{
+  if (stopped)
+    return;
+
+  lock_acquire (&ahead_lock);
+  if (ahead_head - ahead_tail < AHEAD_SIZE)
+    {
+      ahead[ahead_head++ % AHEAD_SIZE] = sector;
+      sema_up (&ahead_avail);
+    }
+  lock_release (&ahead_lock);
+}
+
+/* Writes every dirty sector in the cache to disk. */
+void
+cache_flush (void)
+{
+  flush_all (false);
+}
+
+/* Stops the cache's background threads from flushing or reading
+   ahead any more sectors, in preparation for a final
+   cache_flush() at shutdown. */
+void
+cache_stop (void)
+{
+  stopped = true;
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %lld hits, %lld misses, %lld read ahead, "
+          "%lld written back\n",
+          hit_cnt, miss_cnt, ahead_cnt, writeback_cnt);
+}
+
+/* Returns the buffer for SECTOR, pinned and with its lock held,
+   taking one from another sector if SECTOR is not cached.  If
+   NEED_DATA is true, the buffer holds SECTOR's contents;
+   otherwise the caller is about to overwrite all of them. */
+static struct buffer *
+buffer_get (block_sector_t sector, bool need_data)
+{
+  struct buffer *b;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      b = buffer_find (sector);
+      if (b != NULL)
+        {
+          b->pin_cnt++;
+          b->accessed = true;
+          hit_cnt++;
+          lock_release (&cache_lock);
+          lock_acquire (&b->lock);
+          break;
+        }
+
+      /* If no buffer could be had without releasing the lock,
+         another thread may have cached SECTOR meanwhile. */
+      b = buffer_evict ();
+      if (b != NULL)
+        {
+          b->sector = sector;
+          b->pin_cnt = 1;
+          b->accessed = true;
+          lock_acquire (&b->lock);
+          b->valid = false;
+          lock_release (&cache_lock);
+          break;
+        }
+    }
+
+  /* A buffer just taken for SECTOR is read in, unless its
+     contents are all about to be overwritten. */
+  if (need_data && !b->valid)
+    {
+      block_read (fs_device, sector, b->data);
+      b->valid = true;
+      miss_cnt++;
+    }
+  return b;
+}
+
+/* Releases buffer B, obtained from buffer_get(). */
+static void
+buffer_put (struct buffer *b)
+{
+  lock_release (&b->lock);
+  lock_acquire (&cache_lock);
+  ASSERT (b->pin_cnt > 0);
+  b->pin_cnt--;
+  lock_release (&cache_lock);
+}
+
+/* Returns the buffer holding SECTOR, or a null pointer if there
+   is none.  CACHE_LOCK must be held. */
+static struct buffer *
+buffer_find (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (buffers[i].sector == sector)
+      return &buffers[i];
+  return NULL;
+}
+
+/* Chooses a buffer to reuse with the clock algorithm and returns
+   it, clean and unpinned.  CACHE_LOCK must be held.  If a dirty
+   buffer has to be written back first, or every buffer is
+   pinned, releases CACHE_LOCK to wait, reacquires it, and
+   returns a null pointer. */
+static struct buffer *
+buffer_evict (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Two sweeps suffice to find an unpinned buffer whose accessed
+     flag is clear, unless every buffer is pinned. */
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct buffer *b = &buffers[hand];
+      hand = (hand + 1) % CACHE_SIZE;
+
+      if (b->pin_cnt > 0)
+        continue;
+      if (b->accessed)
+        {
+          b->accessed = false;
+          continue;
+        }
+      if (!b->dirty)
+        return b;
+
+      /* Write back a dirty victim before reusing it, so that no
+         one can read a stale copy of its sector from disk in the
+         meantime. */
+      b->pin_cnt++;
+      lock_release (&cache_lock);
+      lock_acquire (&b->lock);
+      buffer_flush (b);
+      lock_release (&b->lock);
+      lock_acquire (&cache_lock);
+      b->pin_cnt--;
+      return NULL;
+    }
+
+  lock_release (&cache_lock);
+  thread_yield ();
+  lock_acquire (&cache_lock);
+  return NULL;
+}
+
+/* Writes buffer B to disk if it is dirty.  B's lock must be
+   held. */
+static void
+buffer_flush (struct buffer *b)
+{
+  ASSERT (lock_held_by_current_thread (&b->lock));
+
+  if (b->dirty)
+    {
+      ASSERT (b->valid);
+      block_write (fs_device, b->sector, b->data);
+      b->dirty = false;
+      writeback_cnt++;
+    }
+}
+
+/* Writes every dirty sector in the cache to disk.  If
+   BACKGROUND is true, gives up as soon as cache_stop() has been
+   called. */
+static void
+flush_all (bool background)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct buffer *b = &buffers[i];
+
+      if (background && stopped)
+        return;
+
+      lock_acquire (&cache_lock);
+      if (b->sector == INVALID_SECTOR)
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      b->pin_cnt++;
+      lock_release (&cache_lock);
+
+      lock_acquire (&b->lock);
+      buffer_flush (b);
+      buffer_put (b);
+    }
+}
+
+/* Background thread that writes dirty sectors to disk every
+   FLUSH_INTERVAL ticks, until cache_stop() is called. */
+static void
+flush_daemon (void *aux UNUSED)
+{
+  while (!stopped)
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      flush_all (true);
+    }
+}
+
+/* Background thread that reads sectors queued by
+   cache_read_ahead() into the cache. */
+static void
+ahead_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+      bool cached;
+
+      sema_down (&ahead_avail);
+      lock_acquire (&ahead_lock);
+      sector = ahead[ahead_tail++ % AHEAD_SIZE];
+      lock_release (&ahead_lock);
+      if (stopped)
+        continue;
+
+      lock_acquire (&cache_lock);
+      cached = buffer_find (sector) != NULL;
+      lock_release (&cache_lock);
+      if (!cached)
+        {
+          buffer_put (buffer_get (sector, true));
+          ahead_cnt++;
+        }
+    }
+}
@@ -1,10 +1,12 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,11 +23,100 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Cache of open directories. */
+static struct slab_cache dir_cache;
+
+/* Serializes searches and changes of directory contents, so that
+   a name cannot be added twice and a file cannot be removed
+   between finding its entry and opening its inode.  Also
+   protects the dentry cache. */
+static struct lock dir_lock;
+
+/* Dentry cache.
+
+   Finding a name in a directory otherwise means reading its
+   entries one by one until the name turns up, or to the end of
+   the directory if it does not.  The dentry cache remembers the
+   outcome of each search, keyed by the directory's sector and
+   the name: where the entry is and what inode it names, or that
+   there is no such entry.  dir_add() and dir_remove() keep it
+   up to date, so a cached answer is always the one a search
+   would give.  The least recently used entry is dropped once
+   DENTRY_MAX are cached. */
+struct dentry
+  {
+    block_sector_t dir;                 /* Directory's sector. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    bool present;                       /* Does DIR contain NAME? */
+    block_sector_t inode_sector;        /* If present, NAME's inode. */
+    off_t ofs;                          /* If present, entry offset. */
+    struct hash_elem hash_elem;         /* Element in dentries. */
+    struct list_elem lru_elem;          /* Element in dentry_lru. */
+  };
+
+/* Maximum number of cached dentries. */
+#define DENTRY_MAX 1024
+
+static struct hash dentries;            /* Cached dentries. */
+static struct list dentry_lru;          /* Most recently used first. */
+static struct slab_cache dentry_cache;  /* Cache of struct dentry. */
+
+/* Statistics. */
+static long long dentry_hits;           /* Names found in the cache. */
+static long long dentry_neg_hits;       /* Absences found in the cache. */
+static long long dentry_misses;         /* Searches of directories. */
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+static struct dentry *dentry_find (const struct dir *, const char *name);
+static void dentry_set (const struct dir *, const char *name,
+                        bool present, block_sector_t, off_t ofs);
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  slab_cache_init (&dir_cache, "dir", sizeof (struct dir),
+                   __alignof__ (struct dir), NULL);
+  lock_init (&dir_lock);
+  if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+    PANIC ("out of memory for dentry cache");
+  list_init (&dentry_lru);
+  slab_cache_init (&dentry_cache, "dentry", sizeof (struct dentry),
+                   __alignof__ (struct dentry), NULL);
+}
+
+/* Prints dentry cache statistics. */
+void
+dir_print_stats (void)
+{
+  printf ("Dentries: %lld hits, %lld negative hits, %lld misses\n",
+          dentry_hits, dentry_neg_hits, dentry_misses);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
+  struct list_elem *e, *next;
+
+  /* Forget whatever was cached about a directory that used to
+     be in SECTOR. */
+  lock_acquire (&dir_lock);
+  for (e = list_begin (&dentry_lru); e != list_end (&dentry_lru); e = next)
+    {
+      struct dentry *d = list_entry (e, struct dentry, lru_elem);
+      next = list_next (e);
+      if (d->dir == sector)
+        {
+          hash_delete (&dentries, &d->hash_elem);
+          list_remove (&d->lru_elem);
+          slab_free (&dentry_cache, d);
+        }
+    }
+  lock_release (&dir_lock);
+
   return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
 }
 
@@ -34,7 +125,7 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = slab_alloc (&dir_cache);
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
@@ -44,7 +135,7 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
+      slab_free (&dir_cache, dir);
       return NULL; 
     }
 }
@@ -72,7 +163,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      slab_free (&dir_cache, dir);
     }
 }
 
@@ -87,27 +178,59 @@ dir_get_inode (struct dir *dir)
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   Answers from the dentry cache if it can, otherwise searches
+   DIR and caches the outcome.
+   dir_lock must be held. */
 static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
+  struct dentry *d;
   struct dir_entry e;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
+  ASSERT (lock_held_by_current_thread (&dir_lock));
+
+  /* No entry has a name this long. */
+  if (strlen (name) > NAME_MAX)
+    return false;
+
+  d = dentry_find (dir, name);
+  if (d != NULL)
+    {
+      if (!d->present)
+        {
+          dentry_neg_hits++;
+          return false;
+        }
+      dentry_hits++;
+      if (ep != NULL)
+        {
+          ep->inode_sector = d->inode_sector;
+          strlcpy (ep->name, d->name, sizeof ep->name);
+          ep->in_use = true;
+        }
+      if (ofsp != NULL)
+        *ofsp = d->ofs;
+      return true;
+    }
 
+  dentry_misses++;
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
       {
+        dentry_set (dir, name, true, e.inode_sector, ofs);
         if (ep != NULL)
           *ep = e;
         if (ofsp != NULL)
           *ofsp = ofs;
         return true;
       }
+  dentry_set (dir, name, false, 0, 0);
   return false;
 }
 
@@ -124,10 +247,12 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  lock_acquire (&dir_lock);
   if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
+  lock_release (&dir_lock);
 
   return *inode != NULL;
 }
@@ -153,6 +278,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
     return false;
 
   /* Check that NAME is not in use. */
+  lock_acquire (&dir_lock);
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
@@ -173,8 +299,11 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    dentry_set (dir, name, true, inode_sector, ofs);
 
  done:
+  lock_release (&dir_lock);
   return success;
 }
 
@@ -193,6 +322,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
+  lock_acquire (&dir_lock);
   if (!lookup (dir, name, &e, &ofs))
     goto done;
 
@@ -205,12 +335,14 @@ dir_remove (struct dir *dir, const char *name)
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dentry_set (dir, name, false, 0, 0);
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  lock_release (&dir_lock);
   inode_close (inode);
   return success;
 }
@@ -222,15 +354,100 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool success = false;
 
+  lock_acquire (&dir_lock);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          success = true;
+          break;
         } 
     }
-  return false;
+  lock_release (&dir_lock);
+  return success;
+}
+
+/* Returns the cached dentry for NAME in DIR, marking it most
+   recently used, or a null pointer if there is none.
+   dir_lock must be held. */
+static struct dentry *
+dentry_find (const struct dir *dir, const char *name)
+{
+  struct dentry key, *d;
+  struct hash_elem *e;
+
+  key.dir = inode_get_inumber (dir->inode);
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  if (e == NULL)
+    return NULL;
+
+  d = hash_entry (e, struct dentry, hash_elem);
+  list_remove (&d->lru_elem);
+  list_push_front (&dentry_lru, &d->lru_elem);
+  return d;
+}
+
+/* Records in the dentry cache that DIR contains NAME, with its
+   entry at OFS naming the inode in INODE_SECTOR, if PRESENT is
+   true, or that it does not contain NAME, if PRESENT is false.
+   If memory is short, may leave NAME uncached instead.
+   dir_lock must be held. */
+static void
+dentry_set (const struct dir *dir, const char *name, bool present,
+            block_sector_t inode_sector, off_t ofs)
+{
+  struct dentry *d;
+
+  ASSERT (lock_held_by_current_thread (&dir_lock));
+
+  d = dentry_find (dir, name);
+  if (d == NULL)
+    {
+      if (hash_size (&dentries) >= DENTRY_MAX)
+        {
+          d = list_entry (list_pop_back (&dentry_lru),
+                          struct dentry, lru_elem);
+          hash_delete (&dentries, &d->hash_elem);
+        }
+      else
+        {
+          d = slab_alloc (&dentry_cache);
+          if (d == NULL)
+            return;
+        }
+      d->dir = inode_get_inumber (dir->inode);
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dentries, &d->hash_elem);
+      list_push_front (&dentry_lru, &d->lru_elem);
+    }
+  d->present = present;
+  d->inode_sector = inode_sector;
+  d->ofs = ofs;
+}
+
+/* Returns a hash value for the dentry that E is in. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+/* Returns true if the dentry that A is in precedes the one B is
+   in. */
+static bool
+dentry_less (const struct hash_elem *a, const struct hash_elem *b,
+             void *aux UNUSED)
+{
+  const struct dentry *da = hash_entry (a, struct dentry, hash_elem);
+  const struct dentry *db = hash_entry (b, struct dentry, hash_elem);
+
+  if (da->dir != db->dir)
+    return da->dir < db->dir;
+  return strcmp (da->name, db->name) < 0;
 }
@@ -13,6 +13,9 @@
 
 struct inode;
 
+void dir_init (void);
+void dir_print_stats (void);
+
 /* Opening and closing directories. */
 bool dir_create (block_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
@@ -4,9 +4,13 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct lock free_map_lock;    /* Protects FREE_MAP and its file. */
+
+static bool commit (size_t sector, size_t cnt, block_sector_t *sectorp);
 
 /* Initializes the free map. */
 void
@@ -17,6 +21,7 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  lock_init (&free_map_lock);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,7 +32,45 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  size_t sector;
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  success = commit (sector, cnt, sectorp);
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Allocates one sector from the free map and stores it into
+   *SECTORP, preferring the first free sector after NEAR, so that
+   a file that grows a sector at a time stays mostly contiguous.
+   Returns true if successful, false if the disk is full or if
+   the free_map file could not be written. */
+bool
+free_map_allocate_near (block_sector_t near, block_sector_t *sectorp)
+{
+  size_t sector = BITMAP_ERROR;
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  if (near + 1 < bitmap_size (free_map))
+    sector = bitmap_scan_and_flip (free_map, near + 1, 1, false);
+  if (sector == BITMAP_ERROR)
+    sector = bitmap_scan_and_flip (free_map, 0, 1, false);
+  success = commit (sector, 1, sectorp);
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Completes the allocation of the CNT sectors starting at SECTOR,
+   just marked in the free map, by writing the free map to disk,
+   and stores SECTOR into *SECTORP.  If SECTOR is BITMAP_ERROR or
+   the free map cannot be written, frees the sectors and returns
+   false.  free_map_lock must be held. */
+static bool
+commit (size_t sector, size_t cnt, block_sector_t *sectorp)
+{
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
       && !bitmap_write (free_map, free_map_file))
@@ -44,9 +87,11 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
   bitmap_write (free_map, free_map_file);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -1,23 +1,48 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of data sectors an inode indexes directly. */
+#define DIRECT_CNT 124
+
+/* Number of sector numbers in an indirect sector. */
+#define PTRS_PER_SECTOR ((size_t) (BLOCK_SECTOR_SIZE \
+                                   / sizeof (block_sector_t)))
+
+/* Largest file, in bytes: the direct sectors, one indirect
+   sector's worth, and one doubly indirect sector's worth. */
+#define MAX_LENGTH ((off_t) ((DIRECT_CNT + PTRS_PER_SECTOR             \
+                              + PTRS_PER_SECTOR * PTRS_PER_SECTOR)   \
+                             * BLOCK_SECTOR_SIZE))
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   The first DIRECT_CNT data sectors are named in the inode
+   itself, the next PTRS_PER_SECTOR in the indirect sector, and
+   the rest in the sectors named in the doubly indirect sector.
+   An entry of 0 means that no sector has been allocated: sector
+   0 holds the free map's inode, so it is never part of a file.
+   Every sector up to LENGTH is allocated. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+    block_sector_t indirect;            /* Indirect sector. */
+    block_sector_t doubly_indirect;     /* Doubly indirect sector. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -31,14 +56,55 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    off_t next_read;                    /* Offset following last read. */
+    struct rwlock lock;                 /* Readers read and write data;
+                                           writers change the length
+                                           or DENY_WRITE_CNT. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Returns entry I of indirect sector SECTOR. */
+static block_sector_t
+index_get (block_sector_t sector, size_t i)
+{
+  block_sector_t entry;
+  cache_read_at (sector, &entry, i * sizeof entry, sizeof entry);
+  return entry;
+}
+
+/* Sets entry I of indirect sector SECTOR to ENTRY. */
+static void
+index_set (block_sector_t sector, size_t i, block_sector_t entry)
+{
+  cache_write_at (sector, &entry, i * sizeof entry, sizeof entry);
+}
+
+/* Returns the sector that holds data sector IDX of the file
+   whose on-disk inode is DISK, or 0 if none is allocated. */
+static block_sector_t
+lookup (const struct inode_disk *disk, size_t idx)
+{
+  block_sector_t sector;
+
+  if (idx < DIRECT_CNT)
+    return disk->direct[idx];
+  idx -= DIRECT_CNT;
+
+  if (idx < PTRS_PER_SECTOR)
+    return disk->indirect != 0 ? index_get (disk->indirect, idx) : 0;
+  idx -= PTRS_PER_SECTOR;
+
+  if (disk->doubly_indirect == 0)
+    return 0;
+  sector = index_get (disk->doubly_indirect, idx / PTRS_PER_SECTOR);
+  return sector != 0 ? index_get (sector, idx % PTRS_PER_SECTOR) : 0;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -48,20 +114,162 @@ byte_to_sector (const struct inode *inode, off_t pos)
 {
   ASSERT (inode != NULL);
   if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+    return lookup (&inode->data, pos / BLOCK_SECTOR_SIZE);
   else
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* If *SECTORP is 0, allocates a sector, preferably the one
+   after NEAR, zeroes it, and stores it in *SECTORP.  Returns
+   true if successful, false if the disk is full. */
+static bool
+alloc_sector (block_sector_t *sectorp, block_sector_t near)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (*sectorp != 0)
+    return true;
+  if (!free_map_allocate_near (near, sectorp))
+    return false;
+  cache_write (*sectorp, zeros);
+  return true;
+}
+
+/* Makes entry I of indirect sector SECTOR name an allocated
+   sector, allocating one as alloc_sector() does if it is 0, and
+   stores that sector in *NEAR.  Returns true if successful,
+   false if the disk is full. */
+static bool
+alloc_entry (block_sector_t sector, size_t i, block_sector_t *near)
+{
+  block_sector_t entry = index_get (sector, i);
+
+  if (entry == 0)
+    {
+      if (!alloc_sector (&entry, *near))
+        return false;
+      index_set (sector, i, entry);
+    }
+  *near = entry;
+  return true;
+}
+
+/* Extends the file whose on-disk inode DISK is stored in sector
+   INUMBER to LENGTH bytes, allocating zeroed data sectors and the
+   indirect sectors that name them.  Each sector is allocated
+   after the one before it if possible, so that a file stays
+   contiguous unless free space is fragmented.  Returns true if
+   successful.  On failure, DISK's length is unchanged, but the
+   sectors allocated so far remain in its index, to be reused by
+   a later extension or released with the file. */
+static bool
+extend (struct inode_disk *disk, block_sector_t inumber, off_t length)
+{
+  size_t old_cnt = bytes_to_sectors (disk->length);
+  size_t new_cnt = bytes_to_sectors (length);
+  block_sector_t near;
+  size_t idx;
+
+  if (length > MAX_LENGTH)
+    return false;
+
+  near = old_cnt > 0 ? lookup (disk, old_cnt - 1) : inumber;
+  for (idx = old_cnt; idx < new_cnt; idx++)
+    {
+      size_t i = idx;
+      bool ok;
+
+      if (i < DIRECT_CNT)
+        {
+          ok = alloc_sector (&disk->direct[i], near);
+          near = disk->direct[i];
+        }
+      else if ((i -= DIRECT_CNT) < PTRS_PER_SECTOR)
+        ok = (alloc_sector (&disk->indirect, near)
+              && alloc_entry (disk->indirect, i, &near));
+      else
+        {
+          block_sector_t sector = near;
+
+          i -= PTRS_PER_SECTOR;
+          ok = (alloc_sector (&disk->doubly_indirect, near)
+                && alloc_entry (disk->doubly_indirect,
+                                i / PTRS_PER_SECTOR, &sector));
+          ok = ok && alloc_entry (sector, i % PTRS_PER_SECTOR, &near);
+        }
+      if (!ok)
+        return false;
+    }
+
+  disk->length = length;
+  return true;
+}
+
+/* Releases indirect sector SECTOR and the sectors it names.  If
+   LEVEL is 2, those are themselves indirect sectors. */
+static void
+release_index (block_sector_t sector, int level)
+{
+  size_t i;
+
+  for (i = 0; i < PTRS_PER_SECTOR; i++)
+    {
+      block_sector_t entry = index_get (sector, i);
+
+      if (entry == 0)
+        continue;
+      if (level > 1)
+        release_index (entry, level - 1);
+      else
+        free_map_release (entry, 1);
+    }
+  free_map_release (sector, 1);
+}
+
+/* Releases all of the data and indirect sectors of the file
+   whose on-disk inode is DISK. */
+static void
+deallocate (const struct inode_disk *disk)
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    if (disk->direct[i] != 0)
+      free_map_release (disk->direct[i], 1);
+  if (disk->indirect != 0)
+    release_index (disk->indirect, 1);
+  if (disk->doubly_indirect != 0)
+    release_index (disk->doubly_indirect, 2);
+}
+
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode' and finding it takes the
+   same time however many inodes are open.  Looked up under a
+   read lock, so that opens of different files need not wait on
+   each other, and changed under a write lock. */
+static struct hash open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Number of inodes removed from open_inodes on last close.
+   Changed under open_inodes_lock. */
+static unsigned close_cnt;
+
+/* Cache of in-memory inodes. */
+static struct slab_cache inode_cache;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+static struct inode *find_open_inode (block_sector_t);
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("out of memory for open inode table");
+  rwlock_init (&open_inodes_lock);
+  slab_cache_init (&inode_cache, "inode", sizeof (struct inode),
+                   __alignof__ (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -84,22 +292,14 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      if (extend (disk_inode, sector, length)) 
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          cache_write (sector, disk_inode);
           success = true; 
         } 
+      else
+        deallocate (disk_inode);
       free (disk_inode);
     }
   return success;
@@ -111,42 +311,96 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *other;
+  unsigned closes;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_read_acquire (&open_inodes_lock);
+  inode = find_open_inode (sector);
+  closes = close_cnt;
+  rwlock_read_release (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
-  /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  /* Allocate memory and read the inode, without holding the
+     lock, so that opens of other inodes need not wait for the
+     disk. */
+  inode = slab_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
-
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->next_read = 0;
+  rwlock_init (&inode->lock);
+  cache_read (inode->sector, &inode->data);
+
+  /* Insert the inode, unless another thread opened it while we
+     did not hold the lock.  If another thread opened, changed,
+     and closed it in the meantime, what we read may be stale, so
+     read it again; closes are rare enough that this seldom
+     happens. */
+  rwlock_write_acquire (&open_inodes_lock);
+  other = find_open_inode (sector);
+  if (other == NULL)
+    {
+      if (close_cnt != closes)
+        cache_read (inode->sector, &inode->data);
+      hash_insert (&open_inodes, &inode->elem);
+    }
+  rwlock_write_release (&open_inodes_lock);
+
+  if (other != NULL)
+    {
+      slab_free (&inode_cache, inode);
+      inode = other;
+    }
   return inode;
 }
 
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+   if SECTOR's inode is not open.  open_inodes_lock must be held,
+   for reading or writing. */
+static struct inode *
+find_open_inode (block_sector_t sector)
+{
+  struct inode key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  return e != NULL ? inode_reopen (hash_entry (e, struct inode, elem)) : NULL;
+}
+
+/* Returns a hash value for the inode that E is in. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if the inode that A is in precedes the one B is
+   in. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      /* Readers of open_inodes may reopen concurrently. */
+      enum intr_level old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -163,25 +417,37 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  enum intr_level old_level;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  /* Drop our reference, and if it was the last, remove the inode
+     from the table before anyone can find it again. */
+  rwlock_write_acquire (&open_inodes_lock);
+  old_level = intr_disable ();
+  last = --inode->open_cnt == 0;
+  intr_set_level (old_level);
+  if (last)
+    {
+      hash_delete (&open_inodes, &inode->elem);
+      close_cnt++;
+    }
+  rwlock_write_release (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          deallocate (&inode->data);
         }
 
-      free (inode); 
+      slab_free (&inode_cache, inode);
     }
 }
 
@@ -196,14 +462,18 @@ inode_remove (struct inode *inode)
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
+   than SIZE if an error occurs or end of file is reached.
+   If the read continues where the previous one left off, the
+   sector following it is read ahead. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  bool sequential;
 
+  rwlock_read_acquire (&inode->lock);
+  sequential = offset == inode->next_read;
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -220,50 +490,53 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      cache_read_at (sector_idx, buffer + bytes_read, sector_ofs,
+                     chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+
+  if (bytes_read > 0)
+    {
+      off_t next_ofs = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+
+      if (sequential && next_ofs < inode_length (inode))
+        cache_read_ahead (byte_to_sector (inode, next_ofs));
+      inode->next_read = offset;
+    }
+  rwlock_read_release (&inode->lock);
 
   return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   first extending INODE if the write goes past end of file.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if INODE cannot be extended far enough.
+   Writes within the file proceed alongside reads and other such
+   writes; a write that extends the file excludes them. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  bool grow = offset + size > inode_length (inode);
+
+  if (grow)
+    rwlock_write_acquire (&inode->lock);
+  else
+    rwlock_read_acquire (&inode->lock);
 
   if (inode->deny_write_cnt)
-    return 0;
+    goto done;
+
+  if (grow && offset + size > inode_length (inode)
+      && extend (&inode->data, inode->sector, offset + size))
+    cache_write (inode->sector, &inode->data);
 
   while (size > 0) 
     {
@@ -281,39 +554,20 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      cache_write_at (sector_idx, buffer + bytes_written, sector_ofs,
+                      chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
+ done:
+  if (grow)
+    rwlock_write_release (&inode->lock);
+  else
+    rwlock_read_release (&inode->lock);
   return bytes_written;
 }
 
@@ -322,8 +576,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  rwlock_write_acquire (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_write_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +588,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rwlock_write_acquire (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_write_release (&inode->lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
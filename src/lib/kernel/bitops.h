@@ -0,0 +1,24 @@
+#ifndef __LIB_KERNEL_BITOPS_H
+#define __LIB_KERNEL_BITOPS_H
+
+#include <stdint.h>
+
+/* Returns the index of the most significant 1-bit in X, or -1
+   if X is 0.  X is scanned one 32-bit half at a time so that GCC
+   emits a `bsr' instruction instead of a call into libgcc, which
+   the kernel does not link. */
+static inline int
+highest_bit (uint64_t x)
+{
+  uint32_t hi = x >> 32;
+  uint32_t lo = x;
+
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  else if (lo != 0)
+    return 31 - __builtin_clz (lo);
+  else
+    return -1;
+}
+
+#endif /* lib/kernel/bitops.h */
@@ -0,0 +1,94 @@
+/* Child process for syn-open test.
+   Opens all of the shared files, in an order of its own, and
+   keeps them open while it creates and opens private files.
+   Then closes some of the shared files and opens them again,
+   checking every file's contents each time it is opened. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-open.h"
+
+const char *test_name = "child-syn-open";
+
+/* Number of private files and of shared files reopened. */
+#define PRIVATE_CNT 20
+
+/* Opens NAME and checks that it contains NAME.
+   Returns the new file descriptor. */
+static int
+open_and_check (const char *name)
+{
+  char buf[8];
+  int fd;
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  memset (buf, 0, sizeof buf);
+  CHECK (read (fd, buf, sizeof buf) == (int) strlen (name),
+         "read \"%s\"", name);
+  compare_bytes (buf, name, strlen (name), 0, name);
+  return fd;
+}
+
+int
+main (int argc, const char *argv[]) 
+{
+  int order[FILE_CNT];
+  int shared_fds[FILE_CNT];
+  int private_fds[PRIVATE_CNT];
+  char name[8];
+  int child_idx;
+  int fd;
+  int i;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  random_init (child_idx);
+  for (i = 0; i < FILE_CNT; i++)
+    order[i] = i;
+  shuffle (order, FILE_CNT, sizeof *order);
+
+  /* Open every shared file. */
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      shared_name (name, order[i]);
+      shared_fds[order[i]] = open_and_check (name);
+    }
+
+  /* Create and open private files. */
+  for (i = 0; i < PRIVATE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "p%d-%02d", child_idx, i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      CHECK (write (fd, name, strlen (name)) == (int) strlen (name),
+             "write \"%s\"", name);
+      private_fds[i] = fd;
+    }
+
+  /* Close some shared files and open them again. */
+  for (i = 0; i < PRIVATE_CNT; i++)
+    {
+      shared_name (name, order[i]);
+      close (shared_fds[order[i]]);
+      shared_fds[order[i]] = open_and_check (name);
+    }
+
+  /* Close and remove everything. */
+  for (i = 0; i < PRIVATE_CNT; i++)
+    {
+      close (private_fds[i]);
+      snprintf (name, sizeof name, "p%d-%02d", child_idx, i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    close (shared_fds[i]);
+
+  return child_idx;
+}
@@ -0,0 +1,74 @@
+/* Creates 1000 files in the root directory, then looks up names
+   in it: opens 100 of the files, tries to open 1000 names that
+   are not there (each twice), and removes and recreates a few
+   files to check that lookups see the changes.
+
+   Without a cache of directory entries, every lookup reads the
+   directory from the start, up to 1000 entries for each name
+   that is not there.  The dentry statistics printed at shutdown
+   show how many lookups were answered without a search. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 1000
+
+static char name[16];
+
+/* Sets NAME to the name of file I with the given PREFIX. */
+static void
+set_name (char prefix, int i)
+{
+  snprintf (name, sizeof name, "%c%03d", prefix, i);
+}
+
+void
+test_main (void) 
+{
+  int fd;
+  int i;
+
+  msg ("create %d files", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      set_name ('f', i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  quiet = false;
+
+  msg ("open %d of them", FILE_CNT / 10);
+  quiet = true;
+  for (i = FILE_CNT - 1; i >= 0; i -= 10)
+    {
+      set_name ('f', i);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      close (fd);
+    }
+  quiet = false;
+
+  msg ("open %d missing files twice", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < 2 * FILE_CNT; i++)
+    {
+      set_name ('g', i % FILE_CNT);
+      CHECK (open (name) == -1, "open \"%s\"", name);
+    }
+  quiet = false;
+
+  msg ("remove and recreate 10 files");
+  quiet = true;
+  for (i = 0; i < 10; i++)
+    {
+      set_name ('f', i * 97);
+      CHECK (remove (name), "remove \"%s\"", name);
+      CHECK (open (name) == -1, "open \"%s\"", name);
+      CHECK (!remove (name), "remove \"%s\" again", name);
+      CHECK (create (name, 0), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      close (fd);
+    }
+  quiet = false;
+}
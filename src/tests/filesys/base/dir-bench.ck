@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-bench) begin
+(dir-bench) create 1000 files
+(dir-bench) open 100 of them
+(dir-bench) open 1000 missing files twice
+(dir-bench) remove and recreate 10 files
+(dir-bench) end
+EOF
+pass;
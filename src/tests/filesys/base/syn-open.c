@@ -0,0 +1,39 @@
+/* Spawns 4 child processes, each of which opens the same 80 files
+   and some files of its own all at once, so that well over 100
+   inodes are open together and many are opened and closed
+   concurrently by more than one process.  Each file must read
+   back the contents it was created with. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/syn-open.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  char name[8];
+  int fd;
+  int i;
+
+  msg ("create %d files", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      shared_name (name, i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      CHECK (write (fd, name, strlen (name)) == (int) strlen (name),
+             "write \"%s\"", name);
+      close (fd);
+    }
+  quiet = false;
+
+  exec_children ("child-syn-open", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
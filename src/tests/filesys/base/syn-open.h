@@ -0,0 +1,17 @@
+#ifndef TESTS_FILESYS_BASE_SYN_OPEN_H
+#define TESTS_FILESYS_BASE_SYN_OPEN_H
+
+#include <stdio.h>
+
+/* Number of files opened by every child. */
+#define FILE_CNT 80
+
+/* Sets NAME to the name of shared file I, which is also its
+   contents. */
+static inline void
+shared_name (char name[8], int i)
+{
+  snprintf (name, 8, "s%02d", i);
+}
+
+#endif /* tests/filesys/base/syn-open.h */
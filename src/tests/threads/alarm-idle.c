@@ -0,0 +1,64 @@
+/* Puts every thread to sleep at once and checks that the CPU
+   spends nearly all of that time in the idle thread.  A sleeper
+   that busy-waits or yields in a loop would instead keep the
+   CPU in kernel threads, driving the idle share toward zero. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of sleeping threads. */
+#define THREAD_CNT 20
+
+/* Number of ticks each thread sleeps. */
+#define SLEEP_TICKS (2 * TIMER_FREQ)
+
+/* Minimum acceptable percentage of idle ticks. */
+#define MIN_IDLE_PCT 90
+
+static thread_func alarm_idle_thread;
+static struct semaphore done_sema;
+
+void
+test_alarm_idle (void) 
+{
+  int64_t start_time, elapsed;
+  long long start_idle, idle;
+  int i;
+
+  sema_init (&done_sema, 0);
+
+  msg ("Putting %d threads to sleep for %d ticks each.",
+       THREAD_CNT, SLEEP_TICKS);
+  start_time = timer_ticks ();
+  start_idle = thread_get_idle_ticks ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, alarm_idle_thread, NULL);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done_sema);
+  elapsed = timer_elapsed (start_time);
+  idle = thread_get_idle_ticks () - start_idle;
+
+  if (elapsed < SLEEP_TICKS)
+    fail ("threads woke up after %"PRId64" ticks, expected at least %d",
+          elapsed, SLEEP_TICKS);
+  if (idle * 100 < elapsed * MIN_IDLE_PCT)
+    fail ("only %lld of %"PRId64" ticks were idle", idle, elapsed);
+  msg ("At least %d%% of ticks were idle.", MIN_IDLE_PCT);
+}
+
+static void
+alarm_idle_thread (void *aux UNUSED) 
+{
+  timer_sleep (SLEEP_TICKS);
+  sema_up (&done_sema);
+}
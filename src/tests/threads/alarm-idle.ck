@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-idle) begin
+(alarm-idle) Putting 20 threads to sleep for 200 ticks each.
+(alarm-idle) At least 90% of ticks were idle.
+(alarm-idle) end
+EOF
+pass;
@@ -0,0 +1,118 @@
+/* Benchmarks bitmap_scan_and_flip() on a nearly full bitmap of
+   1M bits, as an allocator sees it when memory is scarce.  All
+   bits are set except isolated single free bits every HOLE_GAP
+   bits and a free run at the end.  Allocations of 1 bit fill the
+   holes one by one; allocations of 8 bits must pass all of them
+   to reach the run at the end.
+
+   Each allocation is timed, then repeated against a copy of the
+   bitmap with a bit-at-a-time scan like the one bitmap_scan()
+   used to do, which must find the same bits. */
+
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/tsc.h"
+
+/* Number of bits in the bitmap. */
+#define BIT_CNT (1024 * 1024)
+
+/* Distance between isolated free bits. */
+#define HOLE_GAP 4099
+
+/* Number of free bits at the end of the bitmap. */
+#define TAIL_CNT 8192
+
+/* Allocations to time for each size. */
+#define OPS 16
+
+static struct bitmap *make_bitmap (void);
+static size_t slow_scan_and_flip (struct bitmap *, size_t cnt);
+static void run (struct bitmap *fast, struct bitmap *slow, size_t cnt);
+
+void
+test_bitmap_bench (void) 
+{
+  struct bitmap *fast = make_bitmap ();
+  struct bitmap *slow = make_bitmap ();
+
+  run (fast, slow, 1);
+  run (fast, slow, 8);
+
+  bitmap_destroy (fast);
+  bitmap_destroy (slow);
+  msg ("done");
+}
+
+/* Returns a new bitmap set up as described at the top of the
+   file. */
+static struct bitmap *
+make_bitmap (void)
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+  size_t i;
+
+  if (b == NULL)
+    fail ("out of memory");
+  bitmap_set_multiple (b, 0, BIT_CNT - TAIL_CNT, true);
+  for (i = HOLE_GAP; i < BIT_CNT - TAIL_CNT; i += HOLE_GAP)
+    bitmap_reset (b, i);
+  return b;
+}
+
+/* Finds the first CNT false bits in B one bit at a time, sets
+   them, and returns the index of the first. */
+static size_t
+slow_scan_and_flip (struct bitmap *b, size_t cnt)
+{
+  size_t i, j;
+
+  for (i = 0; i + cnt <= bitmap_size (b); i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j))
+          break;
+      if (j == cnt)
+        {
+          bitmap_set_multiple (b, i, cnt, true);
+          return i;
+        }
+    }
+  return BITMAP_ERROR;
+}
+
+/* Makes OPS allocations of CNT bits from FAST and from SLOW,
+   checking that both find the same bits, and reports the cycles
+   each took per allocation. */
+static void
+run (struct bitmap *fast, struct bitmap *slow, size_t cnt)
+{
+  uint64_t fast_cycles = 0, slow_cycles = 0;
+  int i;
+
+  for (i = 0; i < OPS; i++)
+    {
+      uint64_t start;
+      size_t fast_idx, slow_idx;
+
+      start = tsc_read ();
+      fast_idx = bitmap_scan_and_flip (fast, 0, cnt, false);
+      fast_cycles += tsc_read () - start;
+
+      start = tsc_read ();
+      slow_idx = slow_scan_and_flip (slow, cnt);
+      slow_cycles += tsc_read () - start;
+
+      if (fast_idx != slow_idx)
+        fail ("%zu-bit allocation %d: word scan found %zu, "
+              "bit scan found %zu", cnt, i, fast_idx, slow_idx);
+    }
+
+  msg ("%zu-bit allocations: %d agree.", cnt, OPS);
+  printf ("%zu-bit allocations: word scan %"PRIu64" cycles, "
+          "bit scan %"PRIu64" cycles per allocation\n",
+          cnt, fast_cycles / OPS, slow_cycles / OPS);
+}
@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# The timings vary from run to run, so only their presence and
+# form are checked.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+foreach my $cnt (1, 8) {
+    fail "$cnt-bit results missing\n"
+      if !grep (/^$cnt-bit allocations: word scan \d+ cycles, bit scan \d+ cycles per allocation$/,
+		@output);
+}
+
+my (@messages) = grep (/^\(/, @output);
+my (@expected) = ("(bitmap-bench) begin",
+		  "(bitmap-bench) 1-bit allocations: 16 agree.",
+		  "(bitmap-bench) 8-bit allocations: 16 agree.",
+		  "(bitmap-bench) done",
+		  "(bitmap-bench) end");
+fail "expected " . scalar (@expected) . " messages, got "
+  . scalar (@messages) . "\n"
+  if @messages != @expected;
+for my $i (0...$#expected) {
+    fail "unexpected message \"$messages[$i]\"\n"
+      if $messages[$i] ne $expected[$i];
+}
+pass;
@@ -0,0 +1,74 @@
+/* Checks sema_down_timeout() and lock_acquire_timeout().  A
+   timed wait on a semaphore that nobody ups must give up after
+   the timeout, but one that is upped in time must succeed.  A
+   thread that gives up waiting for a lock must withdraw the
+   priority it donated to the lock's holder. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func up_thread_func;
+static thread_func waiter_thread_func;
+
+void
+test_lock_timeout (void) 
+{
+  struct semaphore sema;
+  struct lock lock;
+  int64_t start;
+  bool success;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&sema, 0);
+  start = timer_ticks ();
+  success = sema_down_timeout (&sema, 10);
+  if (success)
+    fail ("sema_down_timeout() on a semaphore nobody ups succeeded.");
+  if (timer_elapsed (start) < 10)
+    fail ("sema_down_timeout() gave up after only %"PRId64" ticks.",
+          timer_elapsed (start));
+  msg ("sema_down_timeout() timed out.");
+
+  thread_create ("up", PRI_DEFAULT + 1, up_thread_func, &sema);
+  start = timer_ticks ();
+  success = sema_down_timeout (&sema, 1000);
+  if (!success || timer_elapsed (start) >= 1000)
+    fail ("sema_down_timeout() on a semaphore upped in time failed.");
+  msg ("sema_down_timeout() succeeded.");
+
+  lock_init (&lock);
+  lock_acquire (&lock);
+  thread_create ("waiter", PRI_DEFAULT + 10, waiter_thread_func, &lock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  timer_sleep (20);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+  lock_release (&lock);
+}
+
+static void
+up_thread_func (void *sema_) 
+{
+  struct semaphore *sema = sema_;
+
+  timer_sleep (5);
+  sema_up (sema);
+}
+
+static void
+waiter_thread_func (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  if (lock_acquire_timeout (lock, 10))
+    fail ("waiter: acquired a lock that is never released in time.");
+  msg ("waiter: timed out.");
+}
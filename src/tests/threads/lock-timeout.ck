@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lock-timeout) begin
+(lock-timeout) sema_down_timeout() timed out.
+(lock-timeout) sema_down_timeout() succeeded.
+(lock-timeout) This thread should have priority 41.  Actual priority: 41.
+(lock-timeout) waiter: timed out.
+(lock-timeout) This thread should have priority 31.  Actual priority: 31.
+(lock-timeout) end
+EOF
+pass;
@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+
+# Checks the output of palloc-bench or palloc-bench-64.  The
+# timings vary from run to run, so only their presence and form
+# are checked.
+sub check_palloc_bench {
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+
+    my ($name) = $test =~ m%([^/]+)$%;
+    foreach my $allocator ('buddy', 'bitmap') {
+	fail "$allocator results missing\n"
+	  if !grep (/^$allocator: \d+ cycles per operation, \d+ failed allocations, largest allocatable request \d+ pages$/,
+		    @output);
+    }
+
+    my (@messages) = grep (/^\(/, @output);
+    my ($p) = "\\(\Q$name\E\\)";
+    my (@expected) = (qr/^$p begin$/,
+		      qr/^$p User pool has \d+ pages\.$/,
+		      qr/^$p buddy: ran 20000 operations\.$/,
+		      qr/^$p bitmap: ran 20000 operations\.$/,
+		      qr/^$p done$/,
+		      qr/^$p end$/);
+    fail "expected " . scalar (@expected) . " messages, got "
+      . scalar (@messages) . "\n"
+      if @messages != @expected;
+    for my $i (0...$#expected) {
+	fail "unexpected message \"$messages[$i]\"\n"
+	  if $messages[$i] !~ $expected[$i];
+    }
+    pass;
+}
+
+1;
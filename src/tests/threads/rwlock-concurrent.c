@@ -0,0 +1,71 @@
+/* The main thread acquires a readers-writer lock for reading.
+   Then it creates three higher-priority readers, which should
+   all acquire the lock for reading at the same time, and a
+   writer, which should wait until every reader has released
+   it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct rwlock_test
+  {
+    struct rwlock rwlock;       /* Lock under test. */
+    struct semaphore go;        /* Tells readers to release. */
+  };
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_concurrent (void) 
+{
+  struct rwlock_test test;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&test.rwlock);
+  sema_init (&test.go, 0);
+
+  rwlock_read_acquire (&test.rwlock);
+  msg ("main: holding read lock.");
+  for (i = 1; i <= 3; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT + 1, reader_thread_func, &test);
+    }
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread_func, &test);
+  msg ("main: releasing read lock.");
+  rwlock_read_release (&test.rwlock);
+
+  for (i = 1; i <= 3; i++)
+    sema_up (&test.go);
+  msg ("main: done.");
+}
+
+static void
+reader_thread_func (void *test_) 
+{
+  struct rwlock_test *test = test_;
+
+  rwlock_read_acquire (&test->rwlock);
+  msg ("%s: got read lock.", thread_name ());
+  sema_down (&test->go);
+  msg ("%s: releasing read lock.", thread_name ());
+  rwlock_read_release (&test->rwlock);
+}
+
+static void
+writer_thread_func (void *test_) 
+{
+  struct rwlock_test *test = test_;
+
+  rwlock_write_acquire (&test->rwlock);
+  msg ("writer: got write lock.");
+  rwlock_write_release (&test->rwlock);
+}
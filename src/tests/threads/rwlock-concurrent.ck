@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-concurrent) begin
+(rwlock-concurrent) main: holding read lock.
+(rwlock-concurrent) reader 1: got read lock.
+(rwlock-concurrent) reader 2: got read lock.
+(rwlock-concurrent) reader 3: got read lock.
+(rwlock-concurrent) main: releasing read lock.
+(rwlock-concurrent) reader 1: releasing read lock.
+(rwlock-concurrent) reader 2: releasing read lock.
+(rwlock-concurrent) reader 3: releasing read lock.
+(rwlock-concurrent) writer: got write lock.
+(rwlock-concurrent) main: done.
+(rwlock-concurrent) end
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* The main thread acquires a readers-writer lock for writing.
+   Then it creates two readers and a writer of higher priority
+   than both, all of which must wait.  (The readers' priorities
+   differ only to fix the order in which they get in.)  When the main thread
+   releases the lock, both readers must get in ahead of the
+   waiting writer, so that writers cannot starve readers. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct rwlock_test
+  {
+    struct rwlock rwlock;       /* Lock under test. */
+    struct semaphore go;        /* Tells readers to release. */
+  };
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_reader_turn (void) 
+{
+  struct rwlock_test test;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&test.rwlock);
+  sema_init (&test.go, 0);
+
+  rwlock_write_acquire (&test.rwlock);
+  msg ("main: holding write lock.");
+  thread_create ("reader 1", PRI_DEFAULT + 2, reader_thread_func, &test);
+  thread_create ("reader 2", PRI_DEFAULT + 1, reader_thread_func, &test);
+  thread_create ("writer", PRI_DEFAULT + 3, writer_thread_func, &test);
+  msg ("main: releasing write lock.");
+  rwlock_write_release (&test.rwlock);
+
+  msg ("main: letting readers go.");
+  sema_up (&test.go);
+  sema_up (&test.go);
+  msg ("main: done.");
+}
+
+static void
+reader_thread_func (void *test_) 
+{
+  struct rwlock_test *test = test_;
+
+  rwlock_read_acquire (&test->rwlock);
+  msg ("%s: got read lock.", thread_name ());
+  sema_down (&test->go);
+  rwlock_read_release (&test->rwlock);
+}
+
+static void
+writer_thread_func (void *test_) 
+{
+  struct rwlock_test *test = test_;
+
+  rwlock_write_acquire (&test->rwlock);
+  msg ("writer: got write lock.");
+  rwlock_write_release (&test->rwlock);
+}
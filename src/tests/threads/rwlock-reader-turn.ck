@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-reader-turn) begin
+(rwlock-reader-turn) main: holding write lock.
+(rwlock-reader-turn) main: releasing write lock.
+(rwlock-reader-turn) reader 1: got read lock.
+(rwlock-reader-turn) reader 2: got read lock.
+(rwlock-reader-turn) main: letting readers go.
+(rwlock-reader-turn) writer: got write lock.
+(rwlock-reader-turn) main: done.
+(rwlock-reader-turn) end
+EOF
+pass;
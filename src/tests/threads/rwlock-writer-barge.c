@@ -0,0 +1,65 @@
+/* The main thread acquires a readers-writer lock for writing and
+   lets two lower-priority readers queue up behind it.  It
+   releases the lock, which admits both readers, but before they
+   get a chance to run it creates a writer of higher priority
+   than everyone.  The writer must not barge in ahead of the
+   readers the release admitted, or a steady stream of writers
+   could starve readers. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_writer_barge (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock);
+
+  rwlock_write_acquire (&rwlock);
+  msg ("main: holding write lock.");
+  thread_create ("reader 1", PRI_DEFAULT - 1, reader_thread_func, &rwlock);
+  thread_create ("reader 2", PRI_DEFAULT - 2, reader_thread_func, &rwlock);
+
+  /* Let the readers run until they block on the lock. */
+  thread_set_priority (PRI_DEFAULT - 3);
+  thread_set_priority (PRI_DEFAULT);
+
+  msg ("main: releasing write lock.");
+  rwlock_write_release (&rwlock);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rwlock);
+
+  msg ("main: letting readers run.");
+  thread_set_priority (PRI_DEFAULT - 3);
+  msg ("main: done.");
+  thread_set_priority (PRI_DEFAULT);
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_read_acquire (rwlock);
+  msg ("%s: got read lock.", thread_name ());
+  rwlock_read_release (rwlock);
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_write_acquire (rwlock);
+  msg ("writer: got write lock.");
+  rwlock_write_release (rwlock);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-barge) begin
+(rwlock-writer-barge) main: holding write lock.
+(rwlock-writer-barge) main: releasing write lock.
+(rwlock-writer-barge) main: letting readers run.
+(rwlock-writer-barge) reader 1: got read lock.
+(rwlock-writer-barge) reader 2: got read lock.
+(rwlock-writer-barge) writer: got write lock.
+(rwlock-writer-barge) main: done.
+(rwlock-writer-barge) end
+EOF
+pass;
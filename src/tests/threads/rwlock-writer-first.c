@@ -0,0 +1,53 @@
+/* The main thread acquires a readers-writer lock for reading.
+   Then it creates a writer, which must wait, followed by a
+   reader of even higher priority.  Although the lock is held
+   only by a reader, the new reader must queue behind the
+   waiting writer, so that a stream of readers cannot starve
+   writers. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_writer_first (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock);
+  rwlock_read_acquire (&rwlock);
+  msg ("main: holding read lock.");
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rwlock);
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rwlock);
+  msg ("main: releasing read lock.");
+  rwlock_read_release (&rwlock);
+  msg ("main: done.");
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_read_acquire (rwlock);
+  msg ("reader: got read lock.");
+  rwlock_read_release (rwlock);
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_write_acquire (rwlock);
+  msg ("writer: got write lock.");
+  rwlock_write_release (rwlock);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-first) begin
+(rwlock-writer-first) main: holding read lock.
+(rwlock-writer-first) main: releasing read lock.
+(rwlock-writer-first) writer: got write lock.
+(rwlock-writer-first) reader: got read lock.
+(rwlock-writer-first) main: done.
+(rwlock-writer-first) end
+EOF
+pass;
@@ -0,0 +1,87 @@
+/* Checks the slab allocator.  Allocates three slabs' worth of
+   objects from a cache, checking that each is aligned and that
+   the constructor ran on it, then frees them all.  The
+   constructor must run once per object, not once per
+   allocation, and a freed object must keep its constructed
+   state.  Finally, slab_shrink() must release the one empty slab
+   the cache keeps. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+
+#define OBJ_ALIGN 16
+#define OBJ_MAGIC 0x0b7ec75a
+
+struct obj
+  {
+    unsigned magic;             /* Set by constructor. */
+    char data[20];
+  };
+
+/* Static, since a cache stays on the list of all caches. */
+static struct slab_cache cache;
+
+static slab_ctor obj_ctor;
+static size_t ctor_cnt;
+
+void
+test_slab_cache (void) 
+{
+  struct obj **objs;
+  struct obj *o;
+  size_t obj_cnt, i;
+
+  slab_cache_init (&cache, "slab-cache", sizeof (struct obj), OBJ_ALIGN,
+                   obj_ctor);
+  obj_cnt = cache.obj_cnt * 3;
+  objs = malloc (obj_cnt * sizeof *objs);
+  if (objs == NULL)
+    fail ("out of memory");
+
+  msg ("allocating 3 slabs of objects");
+  for (i = 0; i < obj_cnt; i++) 
+    {
+      objs[i] = slab_alloc (&cache);
+      if (objs[i] == NULL)
+        fail ("slab_alloc() failed on object %zu", i);
+      if ((uintptr_t) objs[i] % OBJ_ALIGN != 0)
+        fail ("object %p is not aligned", objs[i]);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %p was not constructed", objs[i]);
+    }
+  if (cache.slab_cnt != 3)
+    fail ("cache has %zu slabs, expected 3", cache.slab_cnt);
+  if (ctor_cnt != obj_cnt)
+    fail ("constructor ran %zu times for %zu objects", ctor_cnt, obj_cnt);
+
+  msg ("freeing all objects");
+  for (i = 0; i < obj_cnt; i++)
+    slab_free (&cache, objs[i]);
+  free (objs);
+  if (cache.in_use != 0)
+    fail ("cache has %zu objects in use after freeing all",
+          cache.in_use);
+
+  msg ("reallocating one object");
+  o = slab_alloc (&cache);
+  if (o == NULL || o->magic != OBJ_MAGIC)
+    fail ("reallocated object lost its constructed state");
+  if (ctor_cnt != obj_cnt)
+    fail ("constructor ran again for a freed object");
+  slab_free (&cache, o);
+
+  msg ("slab_shrink() freed %zu slab(s)", slab_shrink (&cache));
+  if (cache.slab_cnt != 0)
+    fail ("cache has %zu slabs after shrinking", cache.slab_cnt);
+}
+
+static void
+obj_ctor (void *o_) 
+{
+  struct obj *o = o_;
+  o->magic = OBJ_MAGIC;
+  ctor_cnt++;
+}
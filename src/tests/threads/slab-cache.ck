@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) allocating 3 slabs of objects
+(slab-cache) freeing all objects
+(slab-cache) reallocating one object
+(slab-cache) slab_shrink() freed 1 slab(s)
+(slab-cache) end
+EOF
+pass;
@@ -17,6 +17,7 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-idle", test_alarm_idle},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -29,6 +30,15 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"rwlock-concurrent", test_rwlock_concurrent},
+    {"rwlock-writer-first", test_rwlock_writer_first},
+    {"rwlock-reader-turn", test_rwlock_reader_turn},
+    {"rwlock-writer-barge", test_rwlock_writer_barge},
+    {"lock-timeout", test_lock_timeout},
+    {"palloc-bench", test_palloc_bench},
+    {"palloc-bench-64", test_palloc_bench},
+    {"slab-cache", test_slab_cache},
+    {"bitmap-bench", test_bitmap_bench},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -0,0 +1,38 @@
+/* Child process of page-share.
+   Computes a checksum of the page of code that contains main(),
+   which should be the same in every copy of this program running
+   at once.  Given argument N > 0, then runs "child-share N-1"
+   and waits for it, so that this copy stays alive while the next
+   one maps the same code.  Returns the checksum, or -1 if a copy
+   further down the chain saw different code. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/cksum.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-share";
+
+#define PAGE_SIZE 4096
+
+int
+main (int argc, char *argv[])
+{
+  const void *code = (const void *) ((uintptr_t) main & ~(PAGE_SIZE - 1));
+  int sum = cksum (code, PAGE_SIZE) & 0x7fffffff;
+  int n = argc > 1 ? atoi (argv[1]) : 0;
+
+  if (n > 0)
+    {
+      char cmd_line[32];
+      pid_t child;
+
+      snprintf (cmd_line, sizeof cmd_line, "child-share %d", n - 1);
+      child = exec (cmd_line);
+      if (child == -1 || wait (child) != sum)
+        return -1;
+    }
+  return sum;
+}
@@ -0,0 +1,24 @@
+/* Runs a chain of CHILD_CNT child-share processes, each of which
+   starts the next and waits for it, so that all of them are
+   running at once and map the same read-only code pages.  Checks
+   that each sees the same code in them.  page-share.ck also
+   checks, from the kernel's statistics, that pages were shared
+   rather than read again for each process. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void)
+{
+  char cmd_line[32];
+  pid_t child;
+
+  snprintf (cmd_line, sizeof cmd_line, "child-share %d", CHILD_CNT - 1);
+  CHECK ((child = exec (cmd_line)) != -1, "exec \"%s\"", cmd_line);
+  CHECK (wait (child) != -1, "wait for \"%s\"", cmd_line);
+}
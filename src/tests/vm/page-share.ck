@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-share) begin
+(page-share) exec "child-share 3"
+(page-share) wait for "child-share 3"
+(page-share) end
+EOF
+
+# Every copy of child-share after the first should have mapped
+# the code already read by the copies still running.
+our ($test);
+my ($stats) = grep (/^Sharing: /, read_text_file ("$test.output"));
+fail "missing \"Sharing:\" statistics\n" if !defined $stats;
+my ($mapped) = $stats =~ /(\d+) mapped without reading/
+  or fail "malformed \"Sharing:\" statistics: $stats\n";
+fail "no pages were mapped without reading\n" if $mapped == 0;
+pass;
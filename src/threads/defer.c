@@ -0,0 +1,136 @@
+#include "threads/defer.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Number of worker threads. */
+#define WORKER_CNT 2
+
+/* Number of items each worker's queue can hold.  Must be a power
+   of 2. */
+#define QUEUE_SIZE 64
+
+/* A queued function call. */
+struct work
+  {
+    defer_func *func;           /* Function to call. */
+    void *aux;                  /* Argument to pass. */
+  };
+
+/* A worker's queue, a ring buffer with a single producer and a
+   single consumer.  Only the producer advances HEAD and only the
+   consumer advances TAIL, so neither side needs a lock.  The
+   producer is whoever has interrupts off: an external interrupt
+   handler, or a thread that called defer_work().  The consumer
+   is the worker thread. */
+struct queue
+  {
+    struct work items[QUEUE_SIZE];
+    volatile unsigned head;     /* Next slot to fill. */
+    volatile unsigned tail;     /* Next slot to run. */
+    struct semaphore avail;     /* Number of queued items. */
+    long long run_cnt;          /* Number of items run. */
+    long long drop_cnt;         /* Number of items dropped as full. */
+  };
+
+static struct queue queues[WORKER_CNT];
+
+static thread_func worker;
+
+/* Initializes the deferred work queues.  Work may be queued
+   from then on, but does not run until defer_start(). */
+void
+defer_init (void)
+{
+  int i;
+
+  for (i = 0; i < WORKER_CNT; i++)
+    {
+      struct queue *q = &queues[i];
+
+      q->head = q->tail = 0;
+      sema_init (&q->avail, 0);
+      q->run_cnt = q->drop_cnt = 0;
+    }
+}
+
+/* Starts the worker threads.  Call after thread_start(). */
+void
+defer_start (void)
+{
+  int i;
+
+  for (i = 0; i < WORKER_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "defer%d", i);
+      thread_create (name, PRI_MAX, worker, &queues[i]);
+    }
+}
+
+/* Queues a call to FUNC with argument AUX, to be made soon by a
+   worker thread.  May be called from an interrupt handler.
+   Returns true if successful, false if the worker's queue is
+   full, in which case FUNC will not be called. */
+bool
+defer_work (defer_func *func, void *aux)
+{
+  struct queue *q = &queues[(uintptr_t) func % WORKER_CNT];
+  enum intr_level old_level;
+  bool ok = false;
+
+  ASSERT (func != NULL);
+
+  old_level = intr_disable ();
+  if (q->head - q->tail < QUEUE_SIZE)
+    {
+      struct work *w = &q->items[q->head % QUEUE_SIZE];
+      w->func = func;
+      w->aux = aux;
+      barrier ();
+      q->head++;
+      sema_up (&q->avail);
+      ok = true;
+    }
+  else
+    q->drop_cnt++;
+  intr_set_level (old_level);
+
+  return ok;
+}
+
+/* Prints deferred work statistics. */
+void
+defer_print_stats (void)
+{
+  int i;
+
+  for (i = 0; i < WORKER_CNT; i++)
+    printf ("Defer: worker %d ran %lld items, dropped %lld\n",
+            i, queues[i].run_cnt, queues[i].drop_cnt);
+}
+
+/* Worker thread.  Runs the work queued on Q, sleeping while Q is
+   empty. */
+static void
+worker (void *q_)
+{
+  struct queue *q = q_;
+
+  for (;;)
+    {
+      struct work w;
+
+      sema_down (&q->avail);
+      w = q->items[q->tail % QUEUE_SIZE];
+      barrier ();
+      q->tail++;
+
+      w.func (w.aux);
+      q->run_cnt++;
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef THREADS_DEFER_H
+#define THREADS_DEFER_H
+
+#include <stdbool.h>
+
+/* Deferred work ("bottom halves").
+
+   An interrupt handler that has more to do than acknowledging
+   its device can queue the rest as a function call to be made
+   later by a kernel worker thread, with interrupts on.  Work
+   queued with the same function always goes to the same worker,
+   so it runs in the order it was queued. */
+
+/* A function to run as deferred work. */
+typedef void defer_func (void *aux);
+
+void defer_init (void);
+void defer_start (void);
+bool defer_work (defer_func *, void *aux);
+void defer_print_stats (void);
+
+#endif /* threads/defer.h */
@@ -15,6 +15,7 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/defer.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -28,6 +29,10 @@
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#ifdef VM
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 #else
 #include "tests/threads/tests.h"
 #endif
@@ -108,15 +113,21 @@ pintos_init (void)
   /* Initialize interrupt handlers. */
   intr_init ();
   timer_init ();
+  defer_init ();
   kbd_init ();
   input_init ();
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  process_init ();
+#endif
+#ifdef VM
+  page_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  defer_start ();
   serial_init_queue ();
   timer_calibrate ();
 
@@ -126,6 +137,9 @@ pintos_init (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  swap_init ();
+#endif
 
   printf ("Boot complete.\n");
   
@@ -260,9 +274,15 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        page_stack_limit = atoi (value);
+#endif
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -383,8 +403,12 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the timer interrupt while idle.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
+#endif
 #endif
           );
   shutdown_power_off ();
@@ -1,4 +1,5 @@
 #include "threads/interrupt.h"
+#include <bitops.h>
 #include <debug.h>
 #include <inttypes.h>
 #include <stdint.h>
@@ -7,6 +8,7 @@
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
 
@@ -47,6 +49,21 @@ static unsigned int unexpected_cnt[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Interrupts-off time, measured in TSC cycles from the moment
+   interrupts are turned off, by intr_disable() or by entry to an
+   external interrupt handler, until they are turned back on, by
+   intr_enable() or by return from the handler.  Bucket B of the
+   histogram counts periods of 2**B to 2**(B+1) - 1 cycles.
+   Interrupts turned on or off behind our back, as by the idle
+   thread's `sti', are not counted. */
+#define IRQOFF_BUCKETS 40
+static uint64_t irqoff_start;   /* When interrupts went off, or 0. */
+static uint64_t irqoff_max;     /* Longest period seen. */
+static unsigned long long irqoff_hist[IRQOFF_BUCKETS];
+
+static void irqoff_begin (void);
+static void irqoff_end (void);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -90,6 +107,9 @@ intr_enable (void)
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (old_level == INTR_OFF)
+    irqoff_end ();
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -110,6 +130,9 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (old_level == INTR_ON)
+    irqoff_begin ();
+
   return old_level;
 }
 
@@ -357,6 +380,7 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
+      irqoff_begin ();
       in_external_intr = true;
       yield_on_return = false;
     }
@@ -384,7 +408,8 @@ intr_handler (struct intr_frame *frame)
       pic_end_of_interrupt (frame->vec_no); 
 
       if (yield_on_return) 
-        thread_yield (); 
+        thread_preempt (); 
+      irqoff_end ();
     }
 }
 
@@ -436,3 +461,46 @@ intr_name (uint8_t vec)
 {
   return intr_names[vec];
 }
+
+/* Notes that interrupts have just been turned off. */
+static void
+irqoff_begin (void)
+{
+  irqoff_start = tsc_read ();
+}
+
+/* Notes that interrupts are about to be turned on, and adds the
+   time they were off to the histogram. */
+static void
+irqoff_end (void)
+{
+  uint64_t cycles;
+  int bucket;
+
+  if (irqoff_start == 0)
+    return;
+  cycles = tsc_read () - irqoff_start;
+  irqoff_start = 0;
+
+  if (cycles > irqoff_max)
+    irqoff_max = cycles;
+
+  bucket = highest_bit (cycles);
+  if (bucket < 0)
+    bucket = 0;
+  else if (bucket >= IRQOFF_BUCKETS)
+    bucket = IRQOFF_BUCKETS - 1;
+  irqoff_hist[bucket]++;
+}
+
+/* Prints the interrupts-off time histogram. */
+void
+intr_print_stats (void)
+{
+  int i;
+
+  printf ("Interrupts: off for at most %llu cycles\n", irqoff_max);
+  for (i = 0; i < IRQOFF_BUCKETS; i++)
+    if (irqoff_hist[i] != 0)
+      printf ("  %llu periods of 2^%d cycles or more\n", irqoff_hist[i], i);
+}
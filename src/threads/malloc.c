@@ -5,9 +5,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 
 /* A simple implementation of malloc().
 
@@ -32,7 +35,42 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   Two refinements keep the common case off the descriptor lock
+   and out of the page allocator.  First, each thread keeps a
+   small "magazine" of free blocks for each of the smallest block
+   sizes.  malloc() and free() use only the current thread's
+   magazine until it runs empty or full, and then take the lock
+   once to move half a magazine's worth of blocks.  Blocks in a
+   magazine count as in use as far as their arena is concerned.
+   A thread's magazines are allocated the first time it uses
+   them, so that threads that never call malloc() do not pay for
+   them in struct thread, which shares a page with the stack.
+   Second, a descriptor keeps up to ARENA_KEEP arenas that have
+   no blocks in use instead of freeing them right away, so that a
+   burst of frees followed by a burst of mallocs does not give an
+   arena back to the page allocator only to take it again.  Once
+   a descriptor has gone ARENA_AGE timer ticks without taking or
+   keeping an empty arena, the idle thread frees the arenas it
+   keeps, so that the pages do not stay tied up for good. */
+
+/* Per-thread cache of free blocks of one size.  Each thread has
+   one for each of the MAG_CLASSES smallest block sizes. */
+#define MAG_CLASSES 5           /* Block sizes 16 through 256 bytes. */
+#define MAG_SIZE 8              /* Blocks per magazine. */
+struct magazine
+  {
+    unsigned cnt;               /* Number of blocks in BLOCKS. */
+    unsigned hits;              /* Allocations served, not yet counted. */
+    void *blocks[MAG_SIZE];     /* Free blocks. */
+  };
+
+/* Number of empty arenas each descriptor keeps. */
+#define ARENA_KEEP 2
+
+/* Timer ticks after which kept empty arenas are freed. */
+#define ARENA_AGE TIMER_FREQ
 
 /* Descriptor. */
 struct desc
@@ -41,6 +79,15 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    size_t empty_cnt;           /* Number of arenas with no blocks used. */
+    int64_t empty_tick;         /* Timer tick when EMPTY_CNT last changed. */
+
+    /* Statistics, protected by LOCK. */
+    unsigned long long mag_hits;     /* Served by a magazine. */
+    unsigned long long mag_refills;  /* Magazines refilled. */
+    unsigned long long mag_drains;   /* Magazines drained. */
+    unsigned long long arena_allocs; /* Arenas obtained from palloc. */
+    unsigned long long arena_frees;  /* Arenas returned to palloc. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -63,9 +110,16 @@ struct block
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
+static struct desc *mags_desc;  /* Descriptor for a thread's magazines. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *desc_get (struct desc *);
+static void desc_put (struct desc *, struct block *);
+static void arena_free (struct desc *, struct arena *);
+static struct magazine *thread_mags (void);
+static bool mag_refill (struct desc *, struct magazine *);
+static void mag_drain (struct desc *, struct magazine *, unsigned cnt);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -81,7 +135,17 @@ malloc_init (void)
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      d->empty_cnt = 0;
+      d->empty_tick = 0;
+      d->mag_hits = d->mag_refills = d->mag_drains = 0;
+      d->arena_allocs = d->arena_frees = 0;
     }
+  ASSERT (desc_cnt >= MAG_CLASSES);
+
+  for (mags_desc = descs; mags_desc < descs + desc_cnt; mags_desc++)
+    if (mags_desc->block_size >= MAG_CLASSES * sizeof (struct magazine))
+      break;
+  ASSERT (mags_desc < descs + desc_cnt);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -92,6 +156,7 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  struct magazine *mags;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -119,7 +184,34 @@ malloc (size_t size)
       return a + 1;
     }
 
+  /* Use the current thread's magazine for small blocks. */
+  if (d < descs + MAG_CLASSES && (mags = thread_mags ()) != NULL)
+    {
+      struct magazine *m = &mags[d - descs];
+
+      if (m->cnt > 0)
+        m->hits++;
+      else if (!mag_refill (d, m))
+        return NULL;
+      return m->blocks[--m->cnt];
+    }
+
   lock_acquire (&d->lock);
+  b = desc_get (d);
+  lock_release (&d->lock);
+  return b;
+}
+
+/* Removes and returns a block from D's free list, creating a new
+   arena if the list is empty.  Returns a null pointer if memory
+   is not available.  D's lock must be held. */
+static struct block *
+desc_get (struct desc *d)
+{
+  struct block *b;
+  struct arena *a;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
 
   /* If the free list is empty, create a new arena. */
   if (list_empty (&d->free_list))
@@ -129,10 +221,7 @@ malloc (size_t size)
       /* Allocate a page. */
       a = palloc_get_page (0);
       if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
+        return NULL; 
 
       /* Initialize arena and add its blocks to the free list. */
       a->magic = ARENA_MAGIC;
@@ -143,16 +232,227 @@ malloc (size_t size)
           struct block *b = arena_to_block (a, i);
           list_push_back (&d->free_list, &b->free_elem);
         }
+      d->arena_allocs++;
+      d->empty_cnt++;
     }
 
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
+  if (a->free_cnt-- == d->blocks_per_arena)
+    {
+      d->empty_cnt--;
+      d->empty_tick = timer_ticks ();
+    }
   return b;
 }
 
+/* Puts block B back on D's free list.  If that leaves B's arena
+   with no blocks in use, and D already keeps ARENA_KEEP empty
+   arenas, frees the arena.  D's lock must be held. */
+static void
+desc_put (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, keep it or free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      if (d->empty_cnt < ARENA_KEEP)
+        {
+          d->empty_cnt++;
+          d->empty_tick = timer_ticks ();
+          return;
+        }
+      arena_free (d, a);
+    }
+}
+
+/* Removes the blocks of arena A, which has none in use, from D's
+   free list and frees A.  D's lock must be held. */
+static void
+arena_free (struct desc *d, struct arena *a)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+  ASSERT (a->free_cnt == d->blocks_per_arena);
+
+  for (i = 0; i < d->blocks_per_arena; i++) 
+    {
+      struct block *b = arena_to_block (a, i);
+      list_remove (&b->free_elem);
+    }
+  palloc_free_page (a);
+  d->arena_frees++;
+}
+
+/* Frees the empty arenas kept by each descriptor that has gone
+   ARENA_AGE ticks without taking or keeping one.  Called by the
+   idle thread, with interrupts on.
+
+   The idle thread must not sleep, and a thread that waited for
+   a lock it held would get no help from priority donation, since
+   the idle thread runs only when nothing else can.  So each
+   descriptor is trimmed with interrupts off, and only if its lock
+   is free; otherwise it waits for the next idle period. */
+void
+malloc_idle (void)
+{
+  struct desc *d;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    {
+      enum intr_level old_level = intr_disable ();
+
+      if (lock_try_acquire (&d->lock))
+        {
+          if (d->empty_cnt > 0 && timer_elapsed (d->empty_tick) >= ARENA_AGE)
+            {
+              struct list_elem *e = list_begin (&d->free_list);
+
+              while (d->empty_cnt > 0)
+                {
+                  struct arena *a;
+
+                  ASSERT (e != list_end (&d->free_list));
+                  a = block_to_arena (list_entry (e, struct block,
+                                                  free_elem));
+                  if (a->free_cnt == d->blocks_per_arena)
+                    {
+                      /* Freeing A may remove E, so start over. */
+                      arena_free (d, a);
+                      d->empty_cnt--;
+                      e = list_begin (&d->free_list);
+                    }
+                  else
+                    e = list_next (e);
+                }
+            }
+          lock_release (&d->lock);
+        }
+      intr_set_level (old_level);
+    }
+}
+
+/* Returns the current thread's array of MAG_CLASSES magazines,
+   allocating it if this is the thread's first use.  Returns a
+   null pointer if memory is not available, in which case the
+   caller goes straight to the descriptor. */
+static struct magazine *
+thread_mags (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->mags == NULL)
+    {
+      struct magazine *mags;
+
+      lock_acquire (&mags_desc->lock);
+      mags = (struct magazine *) desc_get (mags_desc);
+      lock_release (&mags_desc->lock);
+      if (mags != NULL)
+        {
+          memset (mags, 0, MAG_CLASSES * sizeof *mags);
+          t->mags = mags;
+        }
+    }
+  return t->mags;
+}
+
+/* Fills empty magazine M with half a magazine of blocks from D.
+   Returns true if at least one block was obtained, false if
+   memory is not available. */
+static bool
+mag_refill (struct desc *d, struct magazine *m)
+{
+  ASSERT (m->cnt == 0);
+
+  lock_acquire (&d->lock);
+  while (m->cnt < MAG_SIZE / 2)
+    {
+      struct block *b = desc_get (d);
+      if (b == NULL)
+        break;
+      m->blocks[m->cnt++] = b;
+    }
+  d->mag_hits += m->hits;
+  m->hits = 0;
+  d->mag_refills++;
+  lock_release (&d->lock);
+
+  return m->cnt > 0;
+}
+
+/* Returns CNT blocks from the top of magazine M to D. */
+static void
+mag_drain (struct desc *d, struct magazine *m, unsigned cnt)
+{
+  ASSERT (cnt <= m->cnt);
+
+  lock_acquire (&d->lock);
+  while (cnt-- > 0)
+    desc_put (d, m->blocks[--m->cnt]);
+  d->mag_hits += m->hits;
+  m->hits = 0;
+  d->mag_drains++;
+  lock_release (&d->lock);
+}
+
+/* Returns the blocks in the current thread's magazines to their
+   descriptors, then frees the magazines themselves.  Called by
+   thread_exit(). */
+void
+malloc_thread_exit (void)
+{
+  struct thread *t = thread_current ();
+  struct magazine *mags = t->mags;
+  size_t i;
+
+  if (mags == NULL)
+    return;
+
+  for (i = 0; i < MAG_CLASSES; i++)
+    if (mags[i].cnt > 0 || mags[i].hits > 0)
+      mag_drain (&descs[i], &mags[i], mags[i].cnt);
+
+  t->mags = NULL;
+  lock_acquire (&mags_desc->lock);
+  desc_put (mags_desc, (struct block *) mags);
+  lock_release (&mags_desc->lock);
+}
+
+/* Prints, for each block size, how many requests the magazines
+   served without taking the descriptor lock, how often they were
+   refilled or drained, and how many arenas were obtained from
+   and returned to the page allocator. */
+void
+malloc_print_stats (void)
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->arena_allocs > 0)
+      {
+        unsigned long long lookups = d->mag_hits + d->mag_refills;
+        printf ("Malloc: %4zu-byte blocks: %llu magazine hits (%llu%%), "
+                "%llu refills, %llu drains, "
+                "%llu arenas allocated, %llu freed\n",
+                d->block_size, d->mag_hits,
+                lookups > 0 ? d->mag_hits * 100 / lookups : 0,
+                d->mag_refills, d->mag_drains,
+                d->arena_allocs, d->arena_frees);
+      }
+}
+
 /* Allocates and return A times B bytes initialized to zeroes.
    Returns a null pointer if memory is not available. */
 void *
@@ -223,6 +523,7 @@ free (void *p)
       struct block *b = p;
       struct arena *a = block_to_arena (b);
       struct desc *d = a->desc;
+      struct magazine *mags = thread_current ()->mags;
       
       if (d != NULL) 
         {
@@ -232,26 +533,21 @@ free (void *p)
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
 
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Small blocks go to the current thread's magazine, if
+             it has one, draining half of it first if it is full. */
+          if (d < descs + MAG_CLASSES && mags != NULL)
             {
-              size_t i;
+              struct magazine *m = &mags[d - descs];
 
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              if (m->cnt == MAG_SIZE)
+                mag_drain (d, m, MAG_SIZE / 2);
+              m->blocks[m->cnt++] = b;
+              return;
             }
-
+  
+          lock_acquire (&d->lock);
+          desc_put (d, b);
           lock_release (&d->lock);
         }
       else
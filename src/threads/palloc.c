@@ -2,13 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,14 +24,71 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
 
-/* A memory pool. */
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept in blocks of 2**ORDER pages, for ORDER from 0 to
+   MAX_ORDER, each aligned (relative to the pool base) to its
+   own size, with one free list per order.  An allocation takes a
+   block of the smallest sufficient order, splitting larger
+   blocks as needed, and gives back the pages it does not use.
+   Freeing merges a block with its "buddy", the other half of the
+   block of the next order up, for as long as the buddy is free
+   too.  Both take O(log n) time.
+
+   A pool's free lists are small enough to update with interrupts
+   off, which lets pages be freed from within the scheduler.  The
+   list element for a free block lives in the block's first
+   page.
+
+   When the CPU would otherwise be idle, the idle thread zeroes
+   pages ahead of time and sets up to ZERO_RESERVE of them aside
+   in each pool, so that single-page PAL_ZERO requests need not
+   wait for a memset().  If a pool runs out of free pages, the
+   reserve goes back to the buddy system before an allocation
+   fails. */
+
+/* Largest block order: blocks of up to 2**MAX_ORDER pages. */
+#define MAX_ORDER 10
+
+/* Marks a page in a pool's order_map that does not begin a
+   free block. */
+#define NOT_FREE 0xff
+
+/* Maximum number of freed thread pages kept for reuse, per
+   pool. */
+#define PAGE_CACHE_SIZE 16
+
+/* Maximum number of pre-zeroed pages kept per pool.  The idle
+   thread does not take the last ZERO_RESERVE free pages of a
+   pool for the reserve. */
+#define ZERO_RESERVE 32
+
+/* A memory pool.  Protected by disabling interrupts. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct bitmap *used_map;            /* Bitmap of used pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    size_t free_cnt;                    /* Number of free pages. */
+
+    /* Buddy system. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks by order. */
+    uint8_t *order_map;                 /* Order of free block starting
+                                           at each page, or NOT_FREE. */
+
+    /* Recently freed thread pages, still marked used in used_map. */
+    void *cache[PAGE_CACHE_SIZE];       /* Stack of cached pages. */
+    size_t cache_cnt;                   /* Number of cached pages. */
+    unsigned long long cache_hits;      /* Allocations from cache. */
+    unsigned long long cache_misses;    /* Allocations from used_map. */
+
+    /* Pages zeroed by the idle thread, still marked used in
+       used_map. */
+    void *zeroed[ZERO_RESERVE];         /* Stack of zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of zeroed pages. */
+    unsigned long long zero_hits;       /* PAL_ZERO served from reserve. */
+    unsigned long long zero_misses;     /* PAL_ZERO zeroed on demand. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +97,11 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void free_block (struct pool *, size_t page_idx, int order);
+static void release_zeroed (struct pool *);
+static void refill_zeroed (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -71,15 +134,37 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+
+  /* Serve a single zeroed page from the reserve if we can. */
+  if (flags & PAL_ZERO)
+    {
+      if (page_cnt == 1 && pool->zeroed_cnt > 0)
+        {
+          pages = pool->zeroed[--pool->zeroed_cnt];
+          pool->zero_hits++;
+          intr_set_level (old_level);
+          return pages;
+        }
+      pool->zero_misses++;
+    }
+
+  page_idx = buddy_alloc (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0)
+    {
+      release_zeroed (pool);
+      page_idx = buddy_alloc (pool, page_cnt);
+    }
+  if (page_idx != BITMAP_ERROR)
+    bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -118,6 +203,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -137,8 +223,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +237,140 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Obtains a page from the kernel pool for a struct thread and
+   its kernel stack, preferring a recently freed thread page.
+   Unlike palloc_get_page(), the page is not zeroed: the caller
+   initializes the struct thread itself, and the stack needs no
+   initialization.  Returns a null pointer if no pages are
+   available. */
+void *
+palloc_get_thread_page (void)
+{
+  struct pool *pool = &kernel_pool;
+  enum intr_level old_level;
+  void *page = NULL;
+
+  old_level = intr_disable ();
+  if (pool->cache_cnt > 0)
+    {
+      page = pool->cache[--pool->cache_cnt];
+      pool->cache_hits++;
+    }
+  else
+    pool->cache_misses++;
+  intr_set_level (old_level);
+
+  if (page == NULL)
+    page = palloc_get_page (0);
+  return page;
+}
+
+/* Frees PAGE, which was obtained with palloc_get_thread_page().
+   The page is kept for reuse if there is room in the cache, in
+   which case it is neither poisoned nor returned to the bitmap.
+   May be called with interrupts off. */
+void
+palloc_free_thread_page (void *page)
+{
+  struct pool *pool = &kernel_pool;
+  enum intr_level old_level;
+  bool cached = false;
+
+  ASSERT (page_from_pool (pool, page));
+
+  old_level = intr_disable ();
+  if (pool->cache_cnt < PAGE_CACHE_SIZE)
+    {
+      pool->cache[pool->cache_cnt++] = page;
+      cached = true;
+    }
+  intr_set_level (old_level);
+
+  if (!cached)
+    palloc_free_page (page);
+}
+
+/* Refills each pool's reserve of zeroed pages.  Called by the
+   idle thread, with interrupts on, so that any thread that
+   becomes ready preempts the zeroing. */
+void
+palloc_zero_idle (void)
+{
+  ASSERT (intr_get_level () == INTR_ON);
+
+  refill_zeroed (&kernel_pool);
+  refill_zeroed (&user_pool);
+}
+
+/* Stores into *PAGE_CNT the number of pages in the user pool, if
+   PAL_USER is set in FLAGS, or else the kernel pool, into
+   *FREE_CNT the number of those pages that are free (counting
+   pages in the zeroed reserve), and into
+   *LARGEST_FREE the number of pages in the largest free block. */
+void
+palloc_pool_stats (enum palloc_flags flags, size_t *page_cnt,
+                   size_t *free_cnt, size_t *largest_free)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  int order;
+
+  old_level = intr_disable ();
+  *page_cnt = pool->page_cnt;
+  *free_cnt = pool->free_cnt + pool->zeroed_cnt;
+  *largest_free = 0;
+  for (order = MAX_ORDER; order >= 0; order--)
+    if (!list_empty (&pool->free_lists[order]))
+      {
+        *largest_free = (size_t) 1 << order;
+        break;
+      }
+  intr_set_level (old_level);
+}
+
+/* Prints thread page cache and zeroed page reserve statistics. */
+void
+palloc_print_stats (void)
+{
+  printf ("Palloc: %llu thread page cache hits, %llu misses\n",
+          kernel_pool.cache_hits, kernel_pool.cache_misses);
+  printf ("Palloc: zeroed reserve: kernel %llu hits, %llu misses; "
+          "user %llu hits, %llu misses\n",
+          kernel_pool.zero_hits, kernel_pool.zero_misses,
+          user_pool.zero_hits, user_pool.zero_misses);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and order_map at its base.
+     Calculate the space needed for them and subtract it from the
+     pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  /* Initialize the pool, with all of its pages free. */
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->order_map = (uint8_t *) base + bm_size;
+  memset (p->order_map, NOT_FREE, page_cnt);
   p->base = base + bm_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = 0;
+  for (order = 0; order <= MAX_ORDER; order++)
+    list_init (&p->free_lists[order]);
+  buddy_free (p, 0, page_cnt);
+  p->cache_cnt = 0;
+  p->cache_hits = p->cache_misses = 0;
+  p->zeroed_cnt = 0;
+  p->zero_hits = p->zero_misses = 0;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +384,165 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Returns the first page of free block E in POOL's free lists. */
+static size_t
+block_idx (const struct pool *pool, struct list_elem *e)
+{
+  return pg_no (e) - pg_no (pool->base);
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no block is large
+   enough.  Interrupts must be off. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  int order = order_for (page_cnt);
+  int o;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Find the smallest free block that is large enough. */
+  if (order > MAX_ORDER)
+    return BITMAP_ERROR;
+  for (o = order; list_empty (&pool->free_lists[o]); o++)
+    if (o == MAX_ORDER)
+      return BITMAP_ERROR;
+  page_idx = block_idx (pool, list_pop_front (&pool->free_lists[o]));
+  pool->order_map[page_idx] = NOT_FREE;
+  pool->free_cnt -= (size_t) 1 << o;
+
+  /* Split it down to ORDER, freeing the upper halves, then free
+     whatever PAGE_CNT does not cover. */
+  while (o > order)
+    {
+      o--;
+      free_block (pool, page_idx + ((size_t) 1 << o), o);
+      pool->free_cnt += (size_t) 1 << o;
+    }
+  buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  return page_idx;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+   largest aligned blocks that cover them.  Interrupts must be
+   off. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  pool->free_cnt += page_cnt;
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order < MAX_ORDER
+             && (page_idx & ((size_t) 1 << order)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Puts the block of 2**ORDER pages at PAGE_IDX in POOL on a free
+   list, first merging it with its buddy for as long as the buddy
+   is free.  Does not update POOL's free page count.  Interrupts
+   must be off. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (order < MAX_ORDER)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->order_map[buddy] != order)
+        break;
+      list_remove ((struct list_elem *) (pool->base + PGSIZE * buddy));
+      pool->order_map[buddy] = NOT_FREE;
+      if (buddy < page_idx)
+        page_idx = buddy;
+      order++;
+    }
+
+  pool->order_map[page_idx] = order;
+  list_push_front (&pool->free_lists[order],
+                   (struct list_elem *) (pool->base + PGSIZE * page_idx));
+}
+
+/* Returns all of POOL's zeroed reserve to the buddy system.
+   Interrupts must be off. */
+static void
+release_zeroed (struct pool *pool)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (pool->zeroed_cnt > 0)
+    {
+      void *page = pool->zeroed[--pool->zeroed_cnt];
+      size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+      bitmap_reset (pool->used_map, page_idx);
+      buddy_free (pool, page_idx, 1);
+    }
+}
+
+/* Zeroes pages and adds them to POOL's reserve until it is full
+   or POOL has no more than ZERO_RESERVE free pages left.  Each
+   page is zeroed with interrupts on. */
+static void
+refill_zeroed (struct pool *pool)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      size_t page_idx;
+      void *page;
+
+      /* Take a free page out of the buddy system. */
+      old_level = intr_disable ();
+      if (pool->zeroed_cnt >= ZERO_RESERVE
+          || pool->free_cnt <= ZERO_RESERVE)
+        {
+          intr_set_level (old_level);
+          break;
+        }
+      page_idx = buddy_alloc (pool, 1);
+      ASSERT (page_idx != BITMAP_ERROR);
+      bitmap_mark (pool->used_map, page_idx);
+      intr_set_level (old_level);
+
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      /* Add it to the reserve, unless the reserve was released
+         and refilled by someone else in the meantime. */
+      old_level = intr_disable ();
+      if (pool->zeroed_cnt < ZERO_RESERVE)
+        pool->zeroed[pool->zeroed_cnt++] = page;
+      else
+        {
+          bitmap_reset (pool->used_map, page_idx);
+          buddy_free (pool, page_idx, 1);
+        }
+      intr_set_level (old_level);
+    }
+}
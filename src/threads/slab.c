@@ -0,0 +1,275 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Each slab is one page.  The page begins with a struct slab,
+   followed by an array of one "next free" index per object, then
+   the objects themselves starting at the cache's FIRST_OFS.
+   Keeping the free list outside the objects leaves their
+   constructed state intact while they are free.
+
+   A cache's slabs are on one of three lists, according to
+   whether all, some, or none of their objects are allocated.
+   Allocation prefers partially used slabs, so that free objects
+   collect in as few slabs as possible.  Up to SLAB_KEEP slabs
+   with no objects allocated are kept for reuse; slab_shrink()
+   returns them to the page allocator. */
+
+/* Magic number for detecting corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Number of empty slabs each cache keeps. */
+#define SLAB_KEEP 1
+
+/* End of a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* Header at the start of a slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of CACHE's lists. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free_head;         /* First free object, or SLAB_END. */
+    uint16_t next[];            /* Next free object after each one. */
+  };
+
+/* All slab caches, for slab_print_stats(). */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *slab_create (struct slab_cache *);
+static void slab_destroy (struct slab_cache *, struct slab *);
+static void *slab_obj (struct slab_cache *, struct slab *, size_t idx);
+
+/* Initializes C as a cache of objects SIZE bytes long, each
+   aligned on an ALIGN-byte boundary, which must be a power of 2.
+   If CTOR is nonnull, it is called on each object when its slab
+   is created.  NAME is used only in statistics and must remain
+   valid as long as C does. */
+void
+slab_cache_init (struct slab_cache *c, const char *name,
+                 size_t size, size_t align, slab_ctor *ctor)
+{
+  size_t n;
+
+  ASSERT (c != NULL);
+  ASSERT (size > 0);
+  ASSERT (align > 0 && (align & (align - 1)) == 0);
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, align);
+  c->ctor = ctor;
+
+  /* Find the largest number of objects that fit in a page along
+     with the slab header and free list. */
+  n = (PGSIZE - sizeof (struct slab)) / (c->obj_size + sizeof (uint16_t));
+  while (n > 0
+         && ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t), align)
+            + n * c->obj_size > PGSIZE)
+    n--;
+  if (n > SLAB_END)
+    n = SLAB_END;
+  ASSERT (n > 0);
+  c->obj_cnt = n;
+  c->first_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                           align);
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->slab_cnt = 0;
+  c->in_use = c->peak_in_use = 0;
+  c->alloc_cnt = c->free_cnt = 0;
+  list_push_back (&all_caches, &c->elem);
+}
+
+/* Allocates and returns an object from C, or a null pointer if
+   memory is not available. */
+void *
+slab_alloc (struct slab_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+
+  /* Find a slab with a free object, creating one if needed. */
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else if (!list_empty (&c->empty))
+    {
+      s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  else
+    {
+      s = slab_create (c);
+      if (s == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take its first free object. */
+  ASSERT (s->free_cnt > 0 && s->free_head != SLAB_END);
+  obj = slab_obj (c, s, s->free_head);
+  s->free_head = s->next[s->free_head];
+  if (--s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  lock_release (&c->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from slab_alloc() on
+   C, to C.  If OBJ is a null pointer, does nothing. */
+void
+slab_free (struct slab_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t ofs, idx;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ofs = (uint8_t *) obj - (uint8_t *) s;
+  ASSERT (ofs >= c->first_ofs && (ofs - c->first_ofs) % c->obj_size == 0);
+  idx = (ofs - c->first_ofs) / c->obj_size;
+  ASSERT (idx < c->obj_cnt);
+
+  lock_acquire (&c->lock);
+
+  s->next[idx] = s->free_head;
+  s->free_head = idx;
+  s->free_cnt++;
+  if (s->free_cnt == c->obj_cnt)
+    {
+      /* Now entirely free: keep it or give it back. */
+      list_remove (&s->elem);
+      if (list_size (&c->empty) < SLAB_KEEP)
+        list_push_front (&c->empty, &s->elem);
+      else
+        slab_destroy (c, s);
+    }
+  else if (s->free_cnt == 1)
+    {
+      /* Was full, now partially used. */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  c->free_cnt++;
+  c->in_use--;
+  lock_release (&c->lock);
+}
+
+/* Returns all of C's slabs that have no objects allocated to the
+   page allocator.  Returns the number of pages freed. */
+size_t
+slab_shrink (struct slab_cache *c)
+{
+  size_t cnt = 0;
+
+  lock_acquire (&c->lock);
+  while (!list_empty (&c->empty))
+    {
+      struct list_elem *e = list_pop_front (&c->empty);
+      slab_destroy (c, list_entry (e, struct slab, elem));
+      cnt++;
+    }
+  lock_release (&c->lock);
+
+  return cnt;
+}
+
+/* Prints statistics for each slab cache: object size, objects per
+   slab, objects in use now and at peak, and the pages backing
+   them. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+
+      if (c->alloc_cnt == 0)
+        continue;
+      printf ("Slab: %s: %zu-byte objects, %zu per slab, "
+              "%zu in use (peak %zu), %zu slabs, "
+              "%llu allocs, %llu frees\n",
+              c->name, c->obj_size, c->obj_cnt,
+              c->in_use, c->peak_in_use, c->slab_cnt,
+              c->alloc_cnt, c->free_cnt);
+    }
+}
+
+/* Obtains a page from the page allocator and makes it a slab for
+   C, with all of its objects free and constructed.  Returns the
+   slab, or a null pointer if memory is not available.  C's lock
+   must be held. */
+static struct slab *
+slab_create (struct slab_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->obj_cnt;
+  s->free_head = 0;
+  for (i = 0; i < c->obj_cnt; i++)
+    {
+      s->next[i] = i + 1 < c->obj_cnt ? i + 1 : SLAB_END;
+      if (c->ctor != NULL)
+        c->ctor (slab_obj (c, s, i));
+    }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns slab S, which must not be on any of C's lists, to the
+   page allocator.  C's lock must be held. */
+static void
+slab_destroy (struct slab_cache *c, struct slab *s)
+{
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  ASSERT (s->free_cnt == c->obj_cnt);
+
+  s->magic = 0;
+  palloc_free_page (s);
+  c->slab_cnt--;
+}
+
+/* Returns object IDX within slab S of cache C. */
+static void *
+slab_obj (struct slab_cache *c, struct slab *s, size_t idx)
+{
+  return (uint8_t *) s + c->first_ofs + idx * c->obj_size;
+}
@@ -0,0 +1,49 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Slab allocator for fixed-size kernel objects.
+
+   A slab cache hands out objects of a single size, carved from
+   pages ("slabs") obtained from the page allocator.  Unlike
+   malloc(), it does not round the object size up to a power of
+   2, so objects pack as tightly as their alignment allows.
+
+   An optional constructor runs once on each object when its slab
+   is created, not on every allocation.  An object must therefore
+   be returned to slab_free() in its constructed state. */
+
+/* Initializes an object in a newly created slab. */
+typedef void slab_ctor (void *obj);
+
+/* A cache of objects of one size. */
+struct slab_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded up to alignment. */
+    size_t obj_cnt;             /* Objects per slab. */
+    size_t first_ofs;           /* Offset of first object in slab. */
+    slab_ctor *ctor;            /* Constructor, or a null pointer. */
+    struct lock lock;           /* Protects the following members. */
+    struct list partial;        /* Slabs with some objects free. */
+    struct list full;           /* Slabs with no objects free. */
+    struct list empty;          /* Slabs with all objects free. */
+    size_t slab_cnt;            /* Slabs on all three lists. */
+    size_t in_use;              /* Objects allocated. */
+    size_t peak_in_use;         /* Maximum of IN_USE. */
+    unsigned long long alloc_cnt;  /* Number of slab_alloc() calls. */
+    unsigned long long free_cnt;   /* Number of slab_free() calls. */
+    struct list_elem elem;      /* Element in list of all caches. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name,
+                      size_t size, size_t align, slab_ctor *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+size_t slab_shrink (struct slab_cache *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -31,6 +31,14 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Maximum length of a chain of lock holders that a donated
+   priority is propagated along. */
+#define DONATION_DEPTH_MAX 8
+
+static void donate_priority (struct thread *);
+static void withdraw_donation (struct thread *);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -101,8 +109,45 @@ sema_try_down (struct semaphore *sema)
   return success;
 }
 
+/* Down or "P" operation on a semaphore, giving up after TICKS
+   timer ticks.  Returns true if the semaphore is decremented,
+   false if TICKS passed first.  If TICKS is zero or negative,
+   acts like sema_try_down().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t ticks)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int64_t deadline;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  deadline = timer_ticks () + ticks;
+  while (sema->value == 0)
+    {
+      if (timer_ticks () >= deadline)
+        {
+          intr_set_level (old_level);
+          return false;
+        }
+      list_push_back (&sema->waiters, &cur->elem);
+      timer_arm_timeout (cur, deadline);
+      thread_block ();
+    }
+  sema->value--;
+  intr_set_level (old_level);
+  return true;
+}
+
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  If the woken thread has a higher priority than
+   the running thread, the running thread yields to it.
 
    This function may be called from an interrupt handler. */
 void
@@ -114,10 +159,20 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      /* Waiters' priorities may change through donation while
+         they sleep, so pick the maximum now rather than keeping
+         the list sorted. */
+      struct list_elem *e = list_max (&sema->waiters,
+                                      thread_priority_less, NULL);
+      struct thread *t = list_entry (e, struct thread, elem);
+      list_remove (e);
+      timer_cancel_timeout (t);
+      thread_unblock (t);
+    }
   sema->value++;
   intr_set_level (old_level);
+  thread_yield_to_higher ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -185,6 +240,10 @@ lock_init (struct lock *lock)
    necessary.  The lock must not already be held by the current
    thread.
 
+   If the lock is held by a lower-priority thread, the current
+   thread donates its priority to the holder, and onward along
+   the chain of locks that the holder is itself waiting for.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -192,12 +251,27 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (lock->holder != NULL)
+    {
+      cur->waiting_lock = lock;
+      donate_priority (cur);
+    }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->held_locks, &lock->elem);
+
+  /* Threads still waiting on LOCK now donate to us. */
+  thread_refresh_priority (cur);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -209,18 +283,66 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->held_locks, &lock->elem);
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Acquires LOCK, sleeping until it becomes available or TICKS
+   timer ticks pass, whichever comes first.  Returns true if LOCK
+   was acquired, false on timeout.  While waiting, the current
+   thread donates its priority to LOCK's holder, as with
+   lock_acquire(); on timeout the donation is withdrawn.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t ticks)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (lock));
+
+  old_level = intr_disable ();
+  if (lock->holder != NULL)
+    {
+      cur->waiting_lock = lock;
+      donate_priority (cur);
+    }
+  success = sema_down_timeout (&lock->semaphore, ticks);
+  cur->waiting_lock = NULL;
+  if (success)
+    {
+      lock->holder = cur;
+      list_push_back (&cur->held_locks, &lock->elem);
+      thread_refresh_priority (cur);
+    }
+  else
+    withdraw_donation (lock->holder);
+  intr_set_level (old_level);
+  thread_yield_to_higher ();
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
+   Any priority donated through LOCK is given up, which may cause
+   the current thread to yield.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -228,11 +350,18 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   lock->holder = NULL;
+  list_remove (&lock->elem);
+  thread_refresh_priority (cur);
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -246,13 +375,65 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Propagates DONOR's priority to the holder of the lock DONOR is
+   waiting for, and from there along the chain of lock holders,
+   stopping at the first holder whose priority does not change.
+   Interrupts must be off. */
+static void
+donate_priority (struct thread *donor)
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; depth < DONATION_DEPTH_MAX; depth++)
+    {
+      struct thread *holder;
+
+      if (donor->waiting_lock == NULL)
+        break;
+      holder = donor->waiting_lock->holder;
+      if (holder == NULL || holder->priority >= donor->priority)
+        break;
+
+      /* DONOR is not on the lock's wait list yet, so raise the
+         holder directly instead of recomputing from waiters. */
+      thread_donate_priority (holder, donor->priority);
+      donor = holder;
+    }
+}
+
+/* Recomputes the priority of HOLDER, whose lock a thread has
+   stopped waiting for without acquiring it, and of the holders
+   down the chain from HOLDER, stopping at the first whose
+   priority does not change.  Interrupts must be off. */
+static void
+withdraw_donation (struct thread *holder)
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; depth < DONATION_DEPTH_MAX && holder != NULL; depth++)
+    {
+      if (!thread_refresh_priority (holder) || holder->waiting_lock == NULL)
+        break;
+      holder = holder->waiting_lock->holder;
+    }
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+static bool sema_elem_priority_less (const struct list_elem *,
+                                     const struct list_elem *,
+                                     void *aux);
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -295,6 +476,7 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -302,7 +484,8 @@ cond_wait (struct condition *cond, struct lock *lock)
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
+   this function signals the highest-priority one of them to wake
+   up from its wait.
    LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -317,8 +500,26 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct list_elem *e = list_max (&cond->waiters,
+                                      sema_elem_priority_less, NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
+}
+
+/* Orders semaphore_elems by ascending priority of the thread
+   waiting on each. */
+static bool
+sema_elem_priority_less (const struct list_elem *a_,
+                         const struct list_elem *b_, void *aux UNUSED)
+{
+  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem,
+                                               elem);
+
+  return a->thread->priority < b->thread->priority;
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -336,3 +537,105 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RWLOCK as held by no one. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_init (&rwlock->lock);
+  cond_init (&rwlock->read_ok);
+  cond_init (&rwlock->write_ok);
+  rwlock->readers = 0;
+  rwlock->writer = false;
+  rwlock->waiting_readers = 0;
+  rwlock->waiting_writers = 0;
+  rwlock->read_gen = 0;
+  rwlock->admitted = 0;
+}
+
+/* Acquires RWLOCK for reading, sleeping while a writer holds it
+   or is waiting for it.  A reader that was waiting when a writer
+   released the lock enters even if other writers are waiting.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_read_acquire (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->lock);
+  if (rwlock->writer || rwlock->waiting_writers > 0)
+    {
+      unsigned gen = rwlock->read_gen;
+
+      rwlock->waiting_readers++;
+      while (rwlock->writer
+             || (rwlock->waiting_writers > 0 && gen == rwlock->read_gen))
+        cond_wait (&rwlock->read_ok, &rwlock->lock);
+      rwlock->waiting_readers--;
+      if (gen != rwlock->read_gen)
+        rwlock->admitted--;
+    }
+  rwlock->readers++;
+  lock_release (&rwlock->lock);
+}
+
+/* Releases RWLOCK, which the current thread holds for reading.
+   The last reader out lets a waiting writer in. */
+void
+rwlock_read_release (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->lock);
+  ASSERT (rwlock->readers > 0);
+  if (--rwlock->readers == 0 && rwlock->waiting_writers > 0)
+    cond_signal (&rwlock->write_ok, &rwlock->lock);
+  lock_release (&rwlock->lock);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no reader or
+   writer holds it and every reader admitted by the last writer
+   to release it has entered.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_write_acquire (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->lock);
+  rwlock->waiting_writers++;
+  while (rwlock->writer || rwlock->readers > 0 || rwlock->admitted > 0)
+    cond_wait (&rwlock->write_ok, &rwlock->lock);
+  rwlock->waiting_writers--;
+  rwlock->writer = true;
+  lock_release (&rwlock->lock);
+}
+
+/* Releases RWLOCK, which the current thread holds for writing.
+   All readers waiting at this point are admitted before the next
+   writer, even one that arrives before they wake up; if there
+   are none, one waiting writer is woken. */
+void
+rwlock_write_release (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->lock);
+  ASSERT (rwlock->writer);
+  rwlock->writer = false;
+  if (rwlock->waiting_readers > 0)
+    {
+      rwlock->admitted = rwlock->waiting_readers;
+      rwlock->read_gen++;
+      cond_broadcast (&rwlock->read_ok, &rwlock->lock);
+    }
+  else if (rwlock->waiting_writers > 0)
+    cond_signal (&rwlock->write_ok, &rwlock->lock);
+  lock_release (&rwlock->lock);
+}
@@ -14,19 +14,22 @@ struct semaphore
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t ticks);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
   };
 
 void lock_init (struct lock *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
+bool lock_acquire_timeout (struct lock *, int64_t ticks);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
@@ -41,6 +44,31 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock.  Any number of readers may hold it at
+   once, or a single writer.  Arriving readers queue behind
+   waiting writers, so a stream of readers cannot starve a
+   writer; when a writer releases the lock, every reader queued
+   by then goes ahead of the next writer, so writers cannot
+   starve readers either. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition read_ok;   /* Signaled when readers may enter. */
+    struct condition write_ok;  /* Signaled when a writer may enter. */
+    int readers;                /* Number of readers holding the lock. */
+    bool writer;                /* True if a writer holds the lock. */
+    int waiting_readers;        /* Number of readers waiting. */
+    int waiting_writers;        /* Number of writers waiting. */
+    unsigned read_gen;          /* Incremented to admit waiting readers. */
+    int admitted;               /* Readers admitted but not yet in. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -1,4 +1,5 @@
 #include "threads/thread.h"
+#include <bitops.h>
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
@@ -7,10 +8,13 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -20,9 +24,17 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO queue per priority level. */
+static struct list ready_queues[PRI_MAX + 1];
+
+/* Bit P is set if and only if ready_queues[P] is nonempty, so
+   the highest ready priority is found with a single bit scan. */
+static uint64_t ready_bitmap;
+
+/* Number of threads in all of the run queues. */
+static int ready_cnt;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -49,21 +61,41 @@ struct kernel_thread_frame
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long voluntary_switches;   /* # of switches to block/yield. */
+static long long involuntary_switches; /* # of switches by preemption. */
+static long long create_cnt;    /* # of calls to thread_create(). */
+static uint64_t create_cycles;  /* Total TSC cycles in thread_create(). */
+static unsigned long long sched_latency[SCHED_LATENCY_BUCKETS];
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+static bool yield_preempted;    /* Is the current yield a preemption? */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler. */
+#define MLFQS_PRIORITY_TICKS 4  /* Priority recalculation interval. */
+static fixed_t load_avg;        /* System load average. */
+
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_update_recent_cpu (struct thread *, void *aux);
+static void mlfqs_second (void);
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static void set_effective_priority (struct thread *, int priority);
+static int ready_queue_highest (void);
+static void yield (bool preempted);
+static void print_thread_sched_stats (struct thread *, void *aux);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
@@ -87,14 +119,21 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
+  ready_bitmap = 0;
+  ready_cnt = 0;
+  load_avg = 0;
   list_init (&all_list);
+#ifdef USERPROG
   list_init (&process_list);
-  lock_init (&process_list_lock);
-  lock_init (&filesys_lock);
+  rwlock_init (&process_list_lock);
+#endif
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -128,6 +167,7 @@ thread_tick (void)
   struct thread *t = thread_current ();
 
   /* Update statistics. */
+  t->run_ticks++;
   if (t == idle_thread)
     idle_ticks++;
 #ifdef USERPROG
@@ -137,17 +177,149 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  /* Update the multi-level feedback queue scheduler.  Only the
+     running thread's recent_cpu changes between once-a-second
+     updates, so it is the only priority that needs recomputing
+     in between. */
+  if (thread_mlfqs)
+    {
+      int64_t now = timer_ticks ();
+
+      if (t != idle_thread)
+        t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+      if (now % TIMER_FREQ == 0)
+        mlfqs_second ();
+      else if (now % MLFQS_PRIORITY_TICKS == 0 && t != idle_thread)
+        mlfqs_update_priority (t);
+      thread_yield_to_higher ();
+    }
+
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
+/* Once-a-second MLFQS update: recomputes load_avg from the
+   number of ready and running threads, then decays every
+   thread's recent_cpu and recomputes its priority.  Called from
+   the timer interrupt. */
+static void
+mlfqs_second (void)
+{
+  int ready_threads = ready_cnt;
+
+  if (thread_current () != idle_thread)
+    ready_threads++;
+
+  /* load_avg = (59/60) * load_avg + (1/60) * ready_threads. */
+  load_avg = (fp_mul (fp_div (fp_from_int (59), fp_from_int (60)), load_avg)
+              + fp_from_int (ready_threads) / 60);
+
+  thread_foreach (mlfqs_update_recent_cpu, NULL);
+}
+
+/* Decays T's recent_cpu by the current load average and
+   recomputes its priority:
+
+     recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice. */
+static void
+mlfqs_update_recent_cpu (struct thread *t, void *aux UNUSED)
+{
+  fixed_t twice_load;
+
+  if (t == idle_thread)
+    return;
+
+  twice_load = load_avg * 2;
+  t->recent_cpu = fp_add_int (fp_mul (fp_div (twice_load,
+                                              fp_add_int (twice_load, 1)),
+                                      t->recent_cpu),
+                              t->nice);
+  mlfqs_update_priority (t);
+}
+
+/* Recomputes T's MLFQS priority, clamped to PRI_MIN..PRI_MAX:
+
+     priority = PRI_MAX - (recent_cpu / 4) - (nice * 2). */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  int priority = PRI_MAX - fp_trunc (t->recent_cpu / 4) - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+
+  t->base_priority = priority;
+  if (priority != t->priority)
+    set_effective_priority (t, priority);
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  if (create_cnt > 0)
+    printf ("Thread: %lld threads created, %llu cycles each on average\n",
+            create_cnt, create_cycles / create_cnt);
+  thread_print_sched_stats ();
+}
+
+/* Copies the scheduling latency histogram into BUCKETS. */
+void
+thread_get_sched_latency (unsigned long long buckets[SCHED_LATENCY_BUCKETS])
+{
+  enum intr_level old_level = intr_disable ();
+  memcpy (buckets, sched_latency, sizeof sched_latency);
+  intr_set_level (old_level);
+}
+
+/* Prints context switch counts, the scheduling latency
+   histogram, and per-thread accounting for every live thread. */
+void
+thread_print_sched_stats (void)
+{
+  unsigned long long buckets[SCHED_LATENCY_BUCKETS];
+  enum intr_level old_level;
+  int i;
+
+  thread_get_sched_latency (buckets);
+  printf ("Thread: %lld voluntary, %lld involuntary context switches\n",
+          voluntary_switches, involuntary_switches);
+  printf ("Thread: scheduling latency in cycles:\n");
+  for (i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+    if (buckets[i] != 0)
+      printf ("  %12llu..%-12llu %llu\n",
+              1ULL << i, (1ULL << (i + 1)) - 1, buckets[i]);
+
+  printf ("Thread: %5s %-16s %10s %14s %8s %8s\n",
+          "tid", "name", "run-ticks", "ready-cycles", "vol", "invol");
+  old_level = intr_disable ();
+  thread_foreach (print_thread_sched_stats, NULL);
+  intr_set_level (old_level);
+}
+
+/* Prints T's scheduler accounting on one line. */
+static void
+print_thread_sched_stats (struct thread *t, void *aux UNUSED)
+{
+  printf ("Thread: %5d %-16s %10lld %14llu %8u %8u\n",
+          t->tid, t->name, t->run_ticks, t->ready_cycles,
+          t->voluntary_switches, t->involuntary_switches);
+}
+
+/* Returns the number of timer ticks spent in the idle thread
+   since boot. */
+long long
+thread_get_idle_ticks (void)
+{
+  enum intr_level old_level = intr_disable ();
+  long long t = idle_ticks;
+  intr_set_level (old_level);
+  return t;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -162,9 +334,10 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread's PRIORITY is higher than the running
+   thread's, the new thread preempts it immediately.  Under the
+   multi-level feedback queue scheduler, PRIORITY is ignored and
+   the new thread inherits the creator's nice and recent_cpu. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux)
@@ -173,12 +346,15 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  uint64_t start = tsc_read ();
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT (function != NULL);
 
-  /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  /* Allocate thread.  init_thread() zeroes the struct thread,
+     so the page itself need not be zeroed. */
+  t = palloc_get_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -201,8 +377,14 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
   sf->ebp = 0;
 
+  old_level = intr_disable ();
+  create_cnt++;
+  create_cycles += tsc_read () - start;
+  intr_set_level (old_level);
+
   /* Add to run queue. */
   thread_unblock (t);
+  thread_yield_to_higher ();
 
   return tid;
 }
@@ -230,7 +412,10 @@ thread_block (void)
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  Callers that want a higher-priority T to
+   run right away follow up with thread_yield_to_higher().  From
+   an interrupt handler, the preemption is instead requested for
+   the moment the handler returns. */
 void
 thread_unblock (struct thread *t)
 {
@@ -240,8 +425,21 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  ready_queue_push (t);
   t->status = THREAD_READY;
+  t->ready_stamp = tsc_read ();
+  t->woken = true;
+  if (intr_context ())
+    {
+      struct thread *cur = running_thread ();
+
+      /* More than one thread is runnable now, so the periodic
+         timer tick must come back. */
+      if (cur == idle_thread)
+        timer_leave_idle ();
+      if (t->priority > cur->priority)
+        intr_yield_on_return ();
+    }
   intr_set_level (old_level);
 }
 
@@ -288,6 +486,7 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  malloc_thread_exit ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -303,6 +502,24 @@ thread_exit (void)
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void)
+{
+  yield (false);
+}
+
+/* Yields the CPU because a higher-priority thread is ready or the
+   current thread's time slice has expired.  The same as
+   thread_yield(), except that the switch is accounted as
+   involuntary. */
+void
+thread_preempt (void)
+{
+  yield (true);
+}
+
+/* Makes the current thread ready and schedules another.
+   PREEMPTED tells whether this was forced on the thread. */
+static void
+yield (bool preempted)
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
@@ -311,12 +528,33 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread)
-    list_push_back (&ready_list, &cur->elem);
+    ready_queue_push (cur);
   cur->status = THREAD_READY;
+  cur->ready_stamp = tsc_read ();
+  cur->woken = false;
+  yield_preempted = preempted;
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU if a ready thread has a higher priority than
+   the running thread.  Within an interrupt handler, arranges to
+   yield when the handler returns instead. */
+void
+thread_yield_to_higher (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool preempt = ready_queue_highest () > thread_current ()->priority;
+
+  intr_set_level (old_level);
+  if (!preempt)
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
+    thread_preempt ();
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -334,11 +572,107 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY.
+   Priority donated through locks the thread holds stays in
+   effect until those locks are released.  Yields if the running
+   thread no longer has the highest priority.  Has no effect
+   under the multi-level feedback queue scheduler, which computes
+   priorities itself. */
 void
 thread_set_priority (int new_priority)
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_refresh_priority (cur);
+  intr_set_level (old_level);
+  thread_yield_to_higher ();
+}
+
+/* Recomputes T's effective priority as the maximum of its base
+   priority and the priorities of all threads waiting on locks T
+   holds, moving T to its new run queue if it is ready.  Returns
+   true if the effective priority changed.  There is no donation
+   under the multi-level feedback queue scheduler.  Interrupts
+   must be off. */
+bool
+thread_refresh_priority (struct thread *t)
+{
+  struct list_elem *le, *te;
+  int priority = t->base_priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (is_thread (t));
+
+  if (thread_mlfqs)
+    return false;
+
+  for (le = list_begin (&t->held_locks); le != list_end (&t->held_locks);
+       le = list_next (le))
+    {
+      struct list *waiters = &list_entry (le, struct lock, elem)
+                              ->semaphore.waiters;
+      for (te = list_begin (waiters); te != list_end (waiters);
+           te = list_next (te))
+        {
+          struct thread *donor = list_entry (te, struct thread, elem);
+          if (donor->priority > priority)
+            priority = donor->priority;
+        }
+    }
+
+  if (priority == t->priority)
+    return false;
+  set_effective_priority (t, priority);
+  return true;
+}
+
+/* Raises T's effective priority to PRIORITY, if that is higher,
+   moving T to its new run queue if it is ready.  Used when a
+   thread starts waiting for a lock T holds.  Interrupts must be
+   off. */
+void
+thread_donate_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (is_thread (t));
+
+  if (priority > t->priority && !thread_mlfqs)
+    set_effective_priority (t, priority);
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching run queue if it is ready.  Interrupts must be off. */
+static void
+set_effective_priority (struct thread *t, int priority)
+{
+  if (t->status == THREAD_READY && t != idle_thread)
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Orders threads, given by their `elem' members, by ascending
+   effective priority. */
+bool
+thread_priority_less (const struct list_elem *a_,
+                      const struct list_elem *b_, void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority < b->priority;
 }
 
 /* Returns the current thread's priority. */
@@ -348,35 +682,53 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, clamped to
+   NICE_MIN..NICE_MAX, and recomputes its priority.  Yields if
+   the running thread no longer has the highest priority. */
 void
-thread_set_nice (int nice UNUSED)
+thread_set_nice (int nice)
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (cur);
+  intr_set_level (old_level);
+  thread_yield_to_higher ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent_cpu_100;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -401,6 +753,19 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Use the idle time to zero pages for later PAL_ZERO
+         requests and to free malloc() arenas left empty for a
+         while, with interrupts on so that any thread that becomes
+         ready preempts us. */
+      intr_enable ();
+      palloc_zero_idle ();
+      malloc_idle ();
+      intr_disable ();
+
+      /* Nothing is runnable, so stop the periodic timer tick if
+         tickless idle is enabled. */
+      timer_enter_idle ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -464,7 +829,17 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  if (thread_mlfqs)
+    {
+      /* Inherit from the creating thread.  For the initial
+         thread, running_thread() is T itself, already zeroed. */
+      struct thread *parent = running_thread ();
+      t->nice = parent->nice;
+      t->recent_cpu = parent->recent_cpu;
+      mlfqs_update_priority (t);
+    }
+  list_init (&t->held_locks);
   t->magic = THREAD_MAGIC;
   t->current_fd = 2;
   t->exit_status = -1;
@@ -489,18 +864,66 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Appends T to the run queue for its priority.  Interrupts
+   must be off. */
+static void
+ready_queue_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&ready_queues[t->priority], &t->elem);
+  ready_bitmap |= (uint64_t) 1 << t->priority;
+  ready_cnt++;
+}
+
+/* Removes ready thread T from its run queue.  Interrupts must be
+   off. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority]))
+    ready_bitmap &= ~((uint64_t) 1 << t->priority);
+  ready_cnt--;
+}
+
+/* Returns the highest priority with a nonempty run queue, or -1
+   if every run queue is empty. */
+static int
+ready_queue_highest (void)
+{
+  return highest_bit (ready_bitmap);
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   idle_thread.
+
+   The thread chosen is the one at the front of the queue for
+   the highest ready priority, so threads of equal priority are
+   scheduled round-robin. */
 static struct thread *
 next_thread_to_run (void)
 {
-  if (list_empty (&ready_list))
+  int priority = ready_queue_highest ();
+  struct list *queue;
+  struct thread *t;
+
+  if (priority < 0)
     return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+  queue = &ready_queues[priority];
+  t = list_entry (list_pop_front (queue), struct thread, elem);
+  if (list_empty (queue))
+    ready_bitmap &= ~((uint64_t) 1 << priority);
+  ready_cnt--;
+  return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -529,6 +952,23 @@ thread_schedule_tail (struct thread *prev)
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
 
+  /* Account for the time spent waiting in the run queue, and for
+     scheduling latency if we were just woken up. */
+  if (cur->ready_stamp != 0)
+    {
+      uint64_t waited = tsc_read () - cur->ready_stamp;
+      int bucket = highest_bit (waited);
+
+      cur->ready_cycles += waited;
+      cur->ready_stamp = 0;
+      if (cur->woken && bucket >= 0)
+        {
+          if (bucket >= SCHED_LATENCY_BUCKETS)
+            bucket = SCHED_LATENCY_BUCKETS - 1;
+          sched_latency[bucket]++;
+        }
+    }
+
   /* Start new time slice. */
   thread_ticks = 0;
 
@@ -545,7 +985,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      palloc_free_thread_page (prev);
     }
 }
 
@@ -562,13 +1002,27 @@ schedule (void)
   struct thread *cur = running_thread ();
   struct thread *next = next_thread_to_run ();
   struct thread *prev = NULL;
+  bool preempted = yield_preempted;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  yield_preempted = false;
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      if (cur->status == THREAD_READY && preempted)
+        {
+          cur->involuntary_switches++;
+          involuntary_switches++;
+        }
+      else
+        {
+          cur->voluntary_switches++;
+          voluntary_switches++;
+        }
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -4,9 +4,13 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/synch.h"
 #include "../filesys/file.h"
 #include <limits.h>
+#ifdef VM
+#include <hash.h>
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -27,6 +31,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the multi-level feedback queue scheduler. */
+#define NICE_MIN -20                    /* Most favorable niceness. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least favorable niceness. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -79,10 +88,12 @@ typedef int tid_t;
    value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
    the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   semaphore wait list (synch.c) or the timer's sleep list
+   (devices/timer.c).  It can be used these ways only because
+   they are mutually exclusive: only a thread in the ready state
+   is on the run queue, whereas only a thread in the blocked
+   state is on a semaphore wait list or the sleep list, and a
+   blocked thread waits for exactly one event. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -90,19 +101,52 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority before donation. */
     struct list_elem allelem;           /* List element for all threads list. */
+    int nice;                           /* Niceness (MLFQS). */
+    fixed_t recent_cpu;                 /* Recent CPU time used (MLFQS). */
     struct file *fd_array[SCHAR_MAX];
     int current_fd;
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for. */
     struct file *file;
 
+    /* Owned by threads/malloc.c. */
+    struct magazine *mags;              /* Cached free blocks, or null. */
+
+    /* Owned by devices/timer.c. */
+    int64_t wake_tick;                  /* Tick at which to wake up. */
+    struct list_elem sleep_elem;        /* List element in sleep list. */
+    bool timed_wait;                    /* Blocked on `elem' with timeout? */
+    bool timed_out;                     /* Woken by timeout? */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 #endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct list pinned_pages;           /* Pages pinned by a syscall. */
+    struct file *exec_file;             /* Executable, for lazy loads. */
+    void *user_esp;                     /* User %esp on syscall entry. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Identifier for next mapping. */
+#endif
+
+    /* Scheduler accounting, owned by thread.c. */
+    long long run_ticks;                /* Timer ticks spent running. */
+    uint64_t ready_cycles;              /* TSC cycles spent ready. */
+    uint64_t ready_stamp;               /* TSC when last made ready. */
+    bool woken;                         /* Made ready by thread_unblock()? */
+    unsigned voluntary_switches;        /* Switched out to block or yield. */
+    unsigned involuntary_switches;      /* Switched out by preemption. */
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -120,6 +164,14 @@ void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+long long thread_get_idle_ticks (void);
+
+/* Histogram of scheduling latency, the TSC cycles from
+   thread_unblock() until the thread runs.  Bucket I counts
+   latencies in [2**I, 2**(I+1)). */
+#define SCHED_LATENCY_BUCKETS 40
+void thread_get_sched_latency (unsigned long long[SCHED_LATENCY_BUCKETS]);
+void thread_print_sched_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -133,6 +185,8 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
+void thread_yield_to_higher (void);
 
 struct thread *get_thread(tid_t tid);
 
@@ -142,6 +196,10 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+bool thread_refresh_priority (struct thread *);
+void thread_donate_priority (struct thread *, int priority);
+bool thread_priority_less (const struct list_elem *,
+                           const struct list_elem *, void *aux);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -4,6 +4,10 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -148,9 +152,30 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* Bring in the page if it is part of the process's address
+     space but has not been touched yet, or if it extends the
+     stack.  A fault in the kernel comes from a system call, so
+     the user stack pointer is the one saved on entry to it. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && thread_current ()->pagedir != NULL)
+    {
+      void *esp = user ? f->esp : thread_current ()->user_esp;
+
+      if (page_load (fault_addr)
+          || (page_grow_stack (fault_addr, esp) && page_load (fault_addr)))
+        return;
+    }
+
+  /* The kernel touched a bad user address on behalf of a system
+     call.  Kill the process rather than the kernel. */
+  if (!user && is_user_vaddr (fault_addr))
+    {
+      thread_current ()->exit_status = -1;
+      thread_exit ();
+    }
+#endif
+
   // printf ("Page fault at %p: %s error %s page in %s context.\n",
   //         fault_addr,
   //         not_present ? "not present" : "rights violation",
@@ -15,15 +15,61 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 #define MAX_ARGS 128
 
+/* Slab caches for process bookkeeping, which would otherwise
+   take a page each. */
+static struct slab_cache process_cache;
+static struct slab_cache child_cache;
+
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 static void setup_arguments(int argc, char **argv, void **esp);
+static slab_ctor process_ctor;
+
+/* Initializes the process and child caches. */
+void
+process_init (void)
+{
+  slab_cache_init (&process_cache, "process", sizeof (struct process),
+                   __alignof__ (struct process), process_ctor);
+  slab_cache_init (&child_cache, "child", sizeof (struct child),
+                   __alignof__ (struct child), NULL);
+}
+
+/* Constructs a struct process in the state process_exit() leaves
+   it in: no children and an unheld child lock. */
+static void
+process_ctor (void *p_)
+{
+  struct process *p = p_;
+  list_init (&p->child_list);
+  lock_init (&p->child_lock);
+}
+
+/* Allocates a struct child, returning a null pointer if memory
+   is not available. */
+struct child *
+child_alloc (void)
+{
+  return slab_alloc (&child_cache);
+}
+
+/* Frees CHILD, which was allocated with child_alloc(). */
+void
+child_free (struct child *child)
+{
+  slab_free (&child_cache, child);
+}
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -54,11 +100,9 @@ process_execute (const char *file_name)
   char *fn = strtok_r(full_fn, " ", &save_ptr);
 
   /* Enter new process in process list */
-  struct process *new_process = palloc_get_page(0);
+  struct process *new_process = slab_alloc(&process_cache);
   if (new_process != NULL) {
     new_process->parent_pid = thread_current()->tid;
-    list_init(&new_process->child_list);
-    lock_init(&new_process->child_lock);
     process_add(new_process);
   } else {
     palloc_free_page(fn_copy);
@@ -70,7 +114,7 @@ process_execute (const char *file_name)
   tid = thread_create (fn, PRI_DEFAULT, start_process, fn_copy);
   if (tid == TID_ERROR) {
     process_remove(new_process);
-    palloc_free_page(new_process);
+    slab_free(&process_cache, new_process);
     palloc_free_page(full_fn);
     palloc_free_page(fn_copy);
     return TID_ERROR;
@@ -109,9 +153,7 @@ start_process (void *file_name_)
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
 
-  lock_acquire(&filesys_lock);
   success = load (file_name, &if_.eip, &if_.esp);
-  lock_release(&filesys_lock);
 
   pid_t pid = thread_current()->tid;
   struct process *current_proc = get_process(pid);
@@ -132,10 +174,8 @@ start_process (void *file_name_)
   }
 
   /* Prevent write access to the file while it's being executed */
-  lock_acquire(&filesys_lock);
   thread_current()->file = filesys_open(file_name);
   file_deny_write(thread_current()->file);
-  lock_release(&filesys_lock);
 
   /* Put arguments on the stack */
   setup_arguments(args_count, args, &if_.esp);
@@ -201,7 +241,7 @@ process_wait (tid_t child_tid)
      free resources */
   exit_status = child_proc->exit_status;
   process_remove_child(&parent->child_lock, child_proc);        //free resources
-  palloc_free_page(child_proc);
+  child_free(child_proc);
 
   return exit_status;
 }
@@ -235,13 +275,28 @@ process_exit (void)
   while (!list_empty(child_list)) {
     struct list_elem *e = list_pop_front(child_list);
     struct child *current = list_entry (e, struct child, childelem);
-    palloc_free_page(current);
+    child_free(current);
   }
   lock_release(&current_proc->child_lock);
 
   /* Remove itself from the list of running processes */
   process_remove(current_proc);
-  palloc_free_page(current_proc);
+  slab_free(&process_cache, current_proc);
+
+#ifdef VM
+  /* Write back and release memory-mapped files and the rest of
+     the address space, then the executable it was loaded from. */
+  if (cur->pagedir != NULL)
+    {
+      mmap_unmap_all ();
+      page_table_destroy ();
+    }
+  if (cur->exec_file != NULL)
+    {
+      file_close(cur->exec_file);
+      cur->exec_file = NULL;
+    }
+#endif
 
   /* Close the thread's opened files */
   for (int i = 0; i < SCHAR_MAX; i++) {
@@ -252,10 +307,8 @@ process_exit (void)
 
   /* Close the executable, allow it to be modified */
   if(cur->file != NULL) {
-    lock_acquire(&filesys_lock);
     file_allow_write(cur->file);
     file_close(cur->file);
-    lock_release(&filesys_lock);
   }
 
   /* Let process_wait() knows the thread is exiting */
@@ -385,6 +438,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
     goto done;
+#ifdef VM
+  page_table_init ();
+#endif
   process_activate ();
 
   /* Open executable file. */
@@ -394,6 +450,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       printf ("load: %s: open failed\n", file_name);
       goto done;
     }
+#ifdef VM
+  /* Segments are read from the file as they are touched, so the
+     process keeps it open until it exits. */
+  t->exec_file = file;
+#endif
 
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
@@ -481,13 +542,17 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifndef VM
   file_close (file);
+#endif
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -546,6 +611,9 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only entered into the supplemental page
+   table here, to be read or zeroed when first touched.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -565,6 +633,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where this page comes from. */
+      if (!page_add_file (upage, file, ofs, page_read_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -584,6 +658,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false;
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -598,13 +673,19 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp)
 {
-  uint8_t *kpage;
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
   bool success = false;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+#ifdef VM
+  /* The arguments are pushed right away, so load the page now. */
+  success = page_add_zero (upage, true) && page_load (upage);
+  if (success)
+    *esp = PHYS_BASE;
+#else
+  uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage != NULL)
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
+      success = install_page (upage, kpage, true);
       if (success)
         *esp = PHYS_BASE;
     //printf("buffer: %p\n", buffer);
@@ -612,9 +693,11 @@ setup_stack (void **esp)
       else
         palloc_free_page (kpage);
     }
+#endif
   return success;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -634,6 +717,7 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
 
 //==========================================================
 // setup_arguments
@@ -697,18 +781,18 @@ setup_arguments(int argc, char **args, void **esp)
 struct process*
 get_process(pid_t p)
 {
-  lock_acquire(&process_list_lock);
+  rwlock_read_acquire(&process_list_lock);
   struct list_elem *e;
   for (e = list_begin (&process_list); e != list_end (&process_list);
        e = list_next (e))
     {
       struct process *proc = list_entry (e, struct process, procelem);
       if (proc->pid == p) {
-        lock_release(&process_list_lock);
+        rwlock_read_release(&process_list_lock);
         return proc;
       }
     }
-  lock_release(&process_list_lock);
+  rwlock_read_release(&process_list_lock);
   return NULL;
 }
 
@@ -719,9 +803,9 @@ get_process(pid_t p)
 void
 process_add(struct process* proc)
 {
-  lock_acquire(&process_list_lock);
+  rwlock_write_acquire(&process_list_lock);
   list_push_back(&process_list, &proc->procelem);
-  lock_release(&process_list_lock);
+  rwlock_write_release(&process_list_lock);
 }
 
 //==========================================================
@@ -731,9 +815,9 @@ process_add(struct process* proc)
 void
 process_remove(struct process* proc)
 {
-  lock_acquire(&process_list_lock);
+  rwlock_write_acquire(&process_list_lock);
   list_remove(&proc->procelem);
-  lock_release(&process_list_lock);
+  rwlock_write_release(&process_list_lock);
 }
 
 //==========================================================
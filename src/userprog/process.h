@@ -23,9 +23,9 @@ struct child {
 };
 
 struct list process_list;             //holding all current processes
-struct lock process_list_lock;        //allows for synchronization
-struct lock filesys_lock;
+struct rwlock process_list_lock;      //readers scan, writers add/remove
 
+void process_init (void);
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
@@ -36,4 +36,6 @@ void process_add(struct process* proc);
 void process_remove(struct process* proc);
 void process_add_child(struct child* ch);
 void process_remove_child(struct lock *child_lock, struct child *child);
+struct child *child_alloc (void);
+void child_free (struct child *);
 #endif /* userprog/process.h */
@@ -5,13 +5,16 @@
 #include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
-#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "process.h"
 #include "devices/input.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 #define DEBUG 0
 
@@ -19,6 +22,8 @@ static void syscall_handler (struct intr_frame *);
 static void *get_vaddr(void *uaddr);
 static void *sc_get_arg(int pos, void *esp);
 static void *sc_get_char_arg(int pos, void *esp);
+static void *sc_get_buffer_arg(int pos, void *esp, unsigned size,
+                               bool write);
 
 void halt(void);
 void exit(int status);
@@ -33,6 +38,10 @@ pid_t exec (const char *cmd_line);
 bool remove(const char *file);
 int read(int fd, void *buffer, unsigned size);
 int wait(pid_t pid);
+#ifdef VM
+mapid_t mmap(int fd, void *addr);
+void munmap(mapid_t mapping);
+#endif
 
 //==========================================================
 // get_vaddr
@@ -45,8 +54,18 @@ static void *get_vaddr(void *uaddr)
   }
 
   struct thread* t = thread_current();
-  void *vaddr = pagedir_get_page(t->pagedir, uaddr);
 
+#ifdef VM
+  /* Bring in the page if needed, growing the stack if it is
+     just below it, and keep it resident until the system call
+     returns */
+  if (!page_pin(uaddr)
+      && !(page_grow_stack(uaddr, t->user_esp) && page_pin(uaddr))) {
+    return NULL;
+  }
+#endif
+
+  void *vaddr = pagedir_get_page(t->pagedir, uaddr);
   return vaddr;
 }
 
@@ -69,20 +88,65 @@ static void *sc_get_arg(int pos, void *esp)
 
 //==========================================================
 // sc_get_char_arg
-// gets ith character argument from stack, checking 
-//  validity of address and contents before returning
+// gets ith character argument from stack, checking validity
+//  of every page of the string up to its null terminator
+//  before returning the user address itself, so that strings
+//  may span pages and the file system never faults on them
 //==========================================================
 static void *sc_get_char_arg(int pos, void *esp)
 {
-  void **str_addr = sc_get_arg(pos, esp);
-  void *str = get_vaddr(*str_addr);
-  char *test_str = get_vaddr(*str_addr);
+  char *str = *((char **) sc_get_arg(pos, esp));
+  char *c;
+
+  for (c = str; ; c++) {
+    if ((c == str || pg_ofs(c) == 0) && get_vaddr(c) == NULL) {   //checking each new page
+      exit(-1);
+    }
+    if (*c == '\0') {
+      break;
+    }
+  }
+
+  return str;
+}
+
+//==========================================================
+// sc_get_buffer_arg
+// gets ith argument from stack as a pointer to a user buffer
+//  of SIZE bytes, checking that every page of the buffer is
+//  valid (and writable, if WRITE) before returning the user
+//  address itself, so that buffers may span pages
+//==========================================================
+static void *sc_get_buffer_arg(int pos, void *esp, unsigned size,
+                               bool write)
+{
+  uint8_t *buffer = *((uint8_t **) sc_get_arg(pos, esp));
+  uint8_t *page;
+
+#ifndef VM
+  (void) write;                 //without VM, page permissions aren't known
+#endif
 
-  if (str == NULL || get_vaddr(*str_addr + strlen(test_str)) == NULL) {         //checking if contents are valid
+  if (buffer == NULL || buffer + size < buffer) {
     exit(-1);
   }
+  if (size == 0) {
+    return buffer;
+  }
 
-  return  str;
+  for (page = pg_round_down(buffer); page <= buffer + size - 1;
+       page += PGSIZE) {
+    if (get_vaddr(page) == NULL) {
+      exit(-1);
+    }
+#ifdef VM
+    if (write && !page_lookup(page)->writable) {
+      exit(-1);
+    }
+#endif
+  }
+
+  return buffer;
 }
 
 //==========================================================
@@ -104,6 +168,9 @@ static void
 syscall_handler (struct intr_frame *f)
 {
   void *esp = f->esp;
+#ifdef VM
+  thread_current()->user_esp = esp;       //for stack growth during the call
+#endif
   void *vaddr_esp = get_vaddr(esp);
   if (vaddr_esp == NULL || get_vaddr(esp + 3) == NULL) {      //checking validity of all 4 bytes
     exit(-1);
@@ -127,8 +194,8 @@ syscall_handler (struct intr_frame *f)
     case SYS_WRITE:
     {
       int fd = *((int *) sc_get_arg(1, esp));
-      void *buffer = sc_get_char_arg(2, esp);
       int size = *((int *) sc_get_arg(3, esp));
+      void *buffer = sc_get_buffer_arg(2, esp, size, false);
 
       retval = write(fd, buffer, size);
       has_retval = true;
@@ -184,8 +251,8 @@ syscall_handler (struct intr_frame *f)
     case SYS_READ:
     {
       int fd = *((int *) sc_get_arg(1, esp));
-      void *buffer = sc_get_char_arg(2, esp);
       int size = *((int *) sc_get_arg(3, esp));
+      void *buffer = sc_get_buffer_arg(2, esp, size, true);
 
       retval = read(fd, buffer, size);
       has_retval = true;
@@ -221,9 +288,32 @@ syscall_handler (struct intr_frame *f)
       int fd = *((int *) sc_get_arg(1, esp));
 
       close(fd);
+      break;
+    }
+#ifdef VM
+    case SYS_MMAP:
+    {
+      int fd = *((int *) sc_get_arg(1, esp));
+      void *addr = *((void **) sc_get_arg(2, esp));
+
+      retval = mmap(fd, addr);
+      has_retval = true;
+      break;
+    }
+    case SYS_MUNMAP:
+    {
+      mapid_t mapping = *((mapid_t *) sc_get_arg(1, esp));
+
+      munmap(mapping);
+      break;
     }
+#endif
   }
 
+#ifdef VM
+  page_unpin_all();
+#endif
+
   // put the return value back on the user's stack if needed
   if (has_retval) {
     f->eax = retval;
@@ -263,7 +353,7 @@ pid_t exec (const char *cmd_line)
 
   struct thread* current = thread_current();
   struct process* parent = get_process(current->tid);
-  struct child* new_child = palloc_get_page(0);
+  struct child* new_child = child_alloc();
 
   if (new_child == NULL) {            //no more memory to allocate
     return -1;
@@ -278,7 +368,7 @@ pid_t exec (const char *cmd_line)
   pid_t p = process_execute(cmd_line);
   if (p == TID_ERROR) {                                     //if process failed
     process_remove_child(&parent->child_lock, new_child);
-    palloc_free_page(new_child);
+    child_free(new_child);
     return -1;
   }
 
@@ -291,7 +381,7 @@ pid_t exec (const char *cmd_line)
   } else {
     // load failed - free resources
     process_remove_child(&parent->child_lock, new_child);
-    palloc_free_page(new_child);  
+    child_free(new_child);  
     return -1;
   }
 }
@@ -331,9 +421,7 @@ int write(int fd, const void *buffer, unsigned size)
     exit(-1);
   }
 
-  lock_acquire(&filesys_lock);
   int retval = file_write(file, buffer, size);
-  lock_release(&filesys_lock);
 
   return retval;
 }
@@ -351,16 +439,13 @@ int open(const char *file)
   struct thread *t = thread_current();
   int fd = t->current_fd;                     //get next available file descriptor
 
-  lock_acquire(&filesys_lock);
   struct file *file_1 = filesys_open(file);
   if (file_1 == NULL) {                         //open failed
-    lock_release(&filesys_lock);
     return -1;
   }
 
   t->fd_array[fd] = file_1;
   t->current_fd++;                          //update file descriptor array 
-  lock_release(&filesys_lock);
 
   return fd;
 }
@@ -380,9 +465,7 @@ void close(int fd){
     file = NULL;
   }
 
-  lock_acquire(&filesys_lock);
   file_close(file);
-  lock_release(&filesys_lock);
 }
 
 //==========================================================
@@ -401,9 +484,7 @@ int filesize(int fd)
     file = NULL;
   }
 
-  lock_acquire(&filesys_lock);
   off_t size = file_length(file);
-  lock_release(&filesys_lock);
   return size;
 }
 
@@ -422,9 +503,7 @@ unsigned tell(int fd){
     file = NULL;
   }
 
-  lock_acquire(&filesys_lock);
   off_t tell = file_tell(file);
-  lock_release(&filesys_lock);
 
   return tell;
 }
@@ -445,9 +524,7 @@ void seek(int fd, unsigned position){
     file = NULL;
   }
 
-  lock_acquire(&filesys_lock);
   file_seek(file, position);
-  lock_release(&filesys_lock);
 }
 
 //==========================================================
@@ -459,9 +536,7 @@ bool create(const char *file, unsigned initial_size){
     exit(-1);
   }
 
-  lock_acquire(&filesys_lock);
   bool retval = filesys_create(file, initial_size);
-  lock_release(&filesys_lock);
 
   return retval;
 }
@@ -496,9 +571,7 @@ int read(int fd, void *buffer, unsigned size){
     exit(-1);
   }
 
-  lock_acquire(&filesys_lock);
   int retval = file_read(file, buffer, size);
-  lock_release(&filesys_lock);
 
   return retval;
 }
@@ -512,9 +585,35 @@ bool remove(const char *file){
     exit(-1);
   }
 
-  lock_acquire(&filesys_lock);
   int retval = filesys_remove(file);
-  lock_release(&filesys_lock);
 
   return retval;
 }
+
+#ifdef VM
+//==========================================================
+// mmap
+// maps an open file into memory at addr, to be paged in
+//  from the file as it is touched
+//==========================================================
+mapid_t mmap(int fd, void *addr)
+{
+  struct thread *t = thread_current();
+
+  if (fd < 2 || fd >= t->current_fd || t->fd_array[fd] == NULL) {   //stdin, stdout or invalid
+    return MAP_FAILED;
+  }
+
+  return mmap_map(t->fd_array[fd], addr);
+}
+
+//==========================================================
+// munmap
+// unmaps a mapping, writing back the pages that were
+//  modified
+//==========================================================
+void munmap(mapid_t mapping)
+{
+  mmap_unmap(mapping);
+}
+#endif
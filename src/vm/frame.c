@@ -0,0 +1,280 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+#include "vm/share.h"
+
+/* Frame table.
+
+   Every user pool page that holds a user page has a struct frame
+   in a global list.  When the user pool is exhausted, a frame is
+   reclaimed by the clock (second-chance) algorithm: a hand sweeps
+   the list, clearing each page's accessed bit and choosing the
+   first page whose bit was already clear.  A shared page counts
+   as accessed if any process mapping it has touched it.  Pages
+   that are pinned or whose lock is held, because they are being
+   loaded, evicted or destroyed, are passed over.
+
+   FRAME_LOCK protects the list and the hand.  It is released
+   before a victim is written out, but the victim's page lock
+   stays held until it is out, so that its owner, if it touches
+   the page meanwhile, waits for the eviction to finish. */
+
+/* Number of times to try eviction before giving up. */
+#define EVICT_TRIES 4
+
+static struct list frames;              /* All frames in use. */
+static struct list_elem *hand;          /* Clock hand, or list end. */
+static struct lock frame_lock;          /* Protects FRAMES and HAND. */
+
+/* Cache of struct frame. */
+static struct slab_cache frame_cache;
+
+/* Statistics. */
+static long long eviction_cnt;          /* Frames reclaimed. */
+
+static struct frame *get_frame (bool zero);
+static void insert_frame (struct frame *);
+static bool try_lock (struct frame *);
+static void unlock (struct frame *);
+static struct frame *evict (void);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  lock_init (&frame_lock);
+  slab_cache_init (&frame_cache, "frame", sizeof (struct frame),
+                   __alignof__ (struct frame), NULL);
+}
+
+/* Obtains a frame for page P, evicting another page if the user
+   pool is empty, and zeroes it if ZERO is true.  P's lock must be
+   held.  Returns the frame, or a null pointer if no frame can be
+   had. */
+struct frame *
+frame_alloc (struct page *p, bool zero)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  f = get_frame (zero);
+  if (f != NULL)
+    {
+      f->page = p;
+      f->share = NULL;
+      insert_frame (f);
+    }
+  return f;
+}
+
+/* Obtains a frame for shared page S, like frame_alloc().  S's
+   lock must be held. */
+struct frame *
+frame_alloc_shared (struct share *s)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&s->lock));
+
+  f = get_frame (false);
+  if (f != NULL)
+    {
+      f->page = NULL;
+      f->share = s;
+      insert_frame (f);
+    }
+  return f;
+}
+
+/* Removes F from the frame table and frees it, along with its
+   page of memory.  The lock of the page it holds must be held. */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (f->page != NULL
+          ? lock_held_by_current_thread (&f->page->lock)
+          : lock_held_by_current_thread (&f->share->lock));
+
+  lock_acquire (&frame_lock);
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  lock_release (&frame_lock);
+
+  palloc_free_page (f->kpage);
+  slab_free (&frame_cache, f);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %lld evictions\n", eviction_cnt);
+}
+
+/* Obtains a page from the user pool, or failing that, evicts a
+   page to reclaim its frame, and zeroes it if ZERO is true.
+   Returns the frame, not yet in the frame table, or a null
+   pointer if no frame can be had. */
+static struct frame *
+get_frame (bool zero)
+{
+  struct frame *f;
+  void *kpage;
+
+  kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  if (kpage != NULL)
+    {
+      f = slab_alloc (&frame_cache);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return NULL;
+        }
+      f->kpage = kpage;
+    }
+  else
+    {
+      int try;
+
+      /* Eviction fails if the page chosen needs swap space and
+         there is none, but another page may not need any. */
+      f = NULL;
+      for (try = 0; f == NULL && try < EVICT_TRIES; try++)
+        f = evict ();
+      if (f == NULL)
+        return NULL;
+      if (zero)
+        memset (f->kpage, 0, PGSIZE);
+    }
+  return f;
+}
+
+/* Adds F to the frame table. */
+static void
+insert_frame (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  lock_release (&frame_lock);
+}
+
+/* Tries to acquire the lock of the page held in F without
+   waiting.  Returns true if successful and the page is not
+   pinned; otherwise, returns false with the lock not held. */
+static bool
+try_lock (struct frame *f)
+{
+  if (f->page != NULL)
+    {
+      struct page *p = f->page;
+
+      if (p->pinned || !lock_try_acquire (&p->lock))
+        return false;
+      if (p->pinned)
+        {
+          lock_release (&p->lock);
+          return false;
+        }
+    }
+  else
+    {
+      struct share *s = f->share;
+
+      if (s->pin_cnt > 0 || !lock_try_acquire (&s->lock))
+        return false;
+      if (s->pin_cnt > 0)
+        {
+          lock_release (&s->lock);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Releases the lock acquired by try_lock() on F. */
+static void
+unlock (struct frame *f)
+{
+  if (f->page != NULL)
+    lock_release (&f->page->lock);
+  else
+    lock_release (&f->share->lock);
+}
+
+/* Advances the clock hand and returns the frame it passed. */
+static struct frame *
+advance_hand (void)
+{
+  struct frame *f;
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Chooses a frame with the clock algorithm, evicts the page in
+   it, and returns the frame, removed from the frame table.
+   Returns a null pointer if no page can be evicted. */
+static struct frame *
+evict (void)
+{
+  struct frame *f = NULL;
+  size_t i, n;
+
+  lock_acquire (&frame_lock);
+
+  /* Two sweeps suffice to find a page whose accessed bit is
+     clear, unless every page is busy or keeps being touched. */
+  n = 2 * list_size (&frames) + 1;
+  for (i = 0; i < n && !list_empty (&frames); i++)
+    {
+      struct frame *cand = advance_hand ();
+
+      if (!try_lock (cand))
+        continue;
+      if (cand->page != NULL
+          ? page_accessed (cand->page)
+          : share_accessed (cand->share))
+        {
+          unlock (cand);
+          continue;
+        }
+
+      list_remove (&cand->elem);
+      f = cand;
+      break;
+    }
+  lock_release (&frame_lock);
+
+  if (f == NULL)
+    return NULL;
+
+  /* Write out the victim, or put it back if there is no room
+     in swap.  A shared page is read-only and never needs any. */
+  if (f->share != NULL)
+    share_evict (f->share);
+  else if (!page_evict (f->page))
+    {
+      insert_frame (f);
+      unlock (f);
+      return NULL;
+    }
+  unlock (f);
+
+  lock_acquire (&frame_lock);
+  eviction_cnt++;
+  lock_release (&frame_lock);
+  return f;
+}
@@ -0,0 +1,26 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+
+struct page;
+struct share;
+
+/* A frame: a page of the user pool holding a user page, either
+   private to one process or shared read-only among several. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct page *page;          /* Private page held, or null. */
+    struct share *share;        /* Shared page held, or null. */
+    struct list_elem elem;      /* Element in frame table. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, bool zero);
+struct frame *frame_alloc_shared (struct share *);
+void frame_free (struct frame *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,150 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   mmap() enters a page of the mapped file into the supplemental
+   page table for each page of the region, without reading any of
+   them; each is read in from the file the first time the process
+   touches it, like the pages of an executable.  Unlike those, a
+   mapped page that the process has written goes back to the
+   file, not to swap, when it is evicted or unmapped, and one that
+   it has not written is simply dropped.  The file is reopened,
+   so that the mapping outlives the descriptor it was made from. */
+
+/* Cache of struct mapping. */
+static struct slab_cache mapping_cache;
+
+static struct mapping *mapping_lookup (mapid_t);
+static void unmap (struct mapping *);
+
+/* Initializes the memory-mapped file module. */
+void
+mmap_init (void)
+{
+  slab_cache_init (&mapping_cache, "mapping", sizeof (struct mapping),
+                   __alignof__ (struct mapping), NULL);
+}
+
+/* Maps all of FILE into the running process's address space
+   starting at ADDR, which must be page-aligned.  Returns the new
+   mapping's identifier, or MAP_FAILED if FILE is empty, ADDR is
+   not suitable, any page of the region is already in use, or
+   memory is not available. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+
+  m = slab_alloc (&mapping_cache);
+  if (m == NULL)
+    return MAP_FAILED;
+
+  m->file = file_reopen (file);
+  length = m->file != NULL ? file_length (m->file) : 0;
+  if (length == 0)
+    goto fail;
+  m->addr = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  /* The whole region must be unused user memory. */
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = (uint8_t *) addr + i * PGSIZE;
+      if (upage < (uint8_t *) addr || !is_user_vaddr (upage)
+          || page_lookup (upage) != NULL)
+        goto fail;
+    }
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_mmap ((uint8_t *) addr + ofs, m->file, ofs,
+                          read_bytes))
+        {
+          while (i-- > 0)
+            page_remove ((uint8_t *) addr + i * PGSIZE);
+          goto fail;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+
+ fail:
+  file_close (m->file);
+  slab_free (&mapping_cache, m);
+  return MAP_FAILED;
+}
+
+/* Unmaps the running process's mapping MAPPING, writing back
+   the pages it has modified.  Does nothing if there is no such
+   mapping. */
+void
+mmap_unmap (mapid_t mapping)
+{
+  struct mapping *m = mapping_lookup (mapping);
+  if (m != NULL)
+    unmap (m);
+}
+
+/* Unmaps all of the running process's mappings, as when it
+   exits. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
+
+/* Returns the running process's mapping with identifier ID, or a
+   null pointer if there is none. */
+static struct mapping *
+mapping_lookup (mapid_t id)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes the pages of M from the running process's address
+   space, writing back those that are dirty, then closes its file
+   and frees it. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove ((uint8_t *) m->addr + i * PGSIZE);
+
+  file_close (m->file);
+
+  list_remove (&m->elem);
+  slab_free (&mapping_cache, m);
+}
@@ -0,0 +1,487 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Each process keeps a hash table of the pages in its address
+   space, keyed by user virtual address.  load() enters each page
+   of the executable here instead of reading it, and the page
+   fault handler calls page_load() to give a page a frame and
+   fill it the first time the process touches it.  Pages that a
+   process never touches are never read from disk and never take
+   a frame.
+
+   When memory runs short, the frame table evicts pages through
+   page_evict().  A page that has been written goes to swap; a
+   clean page is just dropped, to be read or zeroed again when it
+   is next touched.  A page of a memory-mapped file that has been
+   written goes back to its file instead (see vm/mmap.c).
+   Read-only file pages, such as program text, are not given
+   frames of their own but shared among processes through
+   vm/share.c.  A system call pins the pages of user memory it
+   uses, so that they stay resident until it returns.
+
+   The stack starts out as the single page holding the program's
+   arguments.  Touching an unmapped address just below the stack
+   pointer adds a zero page there, up to page_stack_limit pages;
+   like any other page, it takes a frame only when it is first
+   touched. */
+
+/* Allowance below the stack pointer for a fault that grows the
+   stack: PUSHA checks 32 bytes below %esp before moving it. */
+#define STACK_SLOP 32
+
+/* Maximum number of pages in a process's stack.
+   Controlled by kernel command-line option "-sl". */
+size_t page_stack_limit = 2048;
+
+/* Cache of struct page. */
+static struct slab_cache page_cache;
+
+/* Statistics. */
+static long long file_loads;    /* Pages read from files. */
+static long long zero_loads;    /* Pages zero-filled. */
+static long long stack_grows;   /* Pages added to stacks. */
+static long long file_writes;   /* Pages written back to files. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static slab_ctor page_ctor;
+static struct page *page_create (void *upage, bool writable,
+                                 enum page_kind);
+static bool page_insert (struct page *);
+static bool load_locked (struct page *, bool pin);
+static void write_back (struct page *);
+
+/* Initializes the supplemental page table module, the frame
+   table, the table of shared pages, and memory-mapped files. */
+void
+page_init (void)
+{
+  slab_cache_init (&page_cache, "page", sizeof (struct page),
+                   __alignof__ (struct page), page_ctor);
+  frame_init ();
+  share_init ();
+  mmap_init ();
+}
+
+/* Initializes the running process's supplemental page table and
+   its list of memory-mapped files. */
+void
+page_table_init (void)
+{
+  struct thread *t = thread_current ();
+
+  if (!hash_init (&t->pages, page_hash, page_less, NULL))
+    PANIC ("out of memory for page table");
+  list_init (&t->pinned_pages);
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+}
+
+/* Destroys the running process's supplemental page table,
+   freeing the frames and swap slots of its pages.  Must be
+   called before the process's page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&thread_current ()->pages, page_destroy);
+}
+
+/* Adds to the running process's address space a page at UPAGE
+   whose first READ_BYTES bytes are read from FILE starting at
+   OFS, with the rest zeroed, when it is first touched.  FILE must
+   stay open as long as the page exists.  Returns true if
+   successful, false if UPAGE is already in use or memory is not
+   available. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+  if (read_bytes == 0)
+    return page_add_zero (upage, writable);
+
+  p = page_create (upage, writable, PAGE_FILE);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return page_insert (p);
+}
+
+/* Adds to the running process's address space a writable page
+   at UPAGE that maps READ_BYTES bytes of FILE starting at OFS,
+   like page_add_file(), except that the page is written back to
+   FILE if it is modified.  Returns true if successful, false if
+   UPAGE is already in use or memory is not available. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = page_create (upage, true, PAGE_MMAP);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return page_insert (p);
+}
+
+/* Adds to the running process's address space a page at UPAGE
+   that reads as all zeros when it is first touched.  Returns true
+   if successful, false if UPAGE is already in use or memory is
+   not available. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  struct page *p = page_create (upage, writable, PAGE_ZERO);
+  return p != NULL && page_insert (p);
+}
+
+/* Removes the page at UPAGE from the running process's address
+   space, freeing it as page_table_destroy() would.  Does nothing
+   if there is no page at UPAGE. */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  if (p != NULL)
+    {
+      hash_delete (&thread_current ()->pages, &p->elem);
+      page_destroy (&p->elem, NULL);
+    }
+}
+
+/* Returns the page in the running process's address space that
+   contains user virtual address ADDR, or a null pointer if there
+   is none. */
+struct page *
+page_lookup (const void *addr)
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (addr);
+  e = hash_find (&t->pages, &p.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Makes the page that contains user virtual address ADDR in the
+   running process's address space resident, obtaining a frame
+   for it and filling it if it is not already.  Returns true if
+   successful, false if ADDR is not in the address space or
+   memory is not available. */
+bool
+page_load (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+  bool success;
+
+  if (p == NULL)
+    return false;
+  lock_acquire (&p->lock);
+  success = load_locked (p, false);
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Decides whether user virtual address ADDR, which is not in the
+   running process's address space, looks like a reference to
+   its stack, given the process's stack pointer ESP.  If so, adds
+   a zero page containing ADDR to the address space and returns
+   true; page_load() then gives it a frame.  Otherwise, returns
+   false. */
+bool
+page_grow_stack (const void *addr, const void *esp)
+{
+  if (!is_user_vaddr (addr) || esp == NULL
+      || (const uint8_t *) addr + STACK_SLOP < (const uint8_t *) esp
+      || pg_no (PHYS_BASE) - pg_no (addr) > page_stack_limit)
+    return false;
+  if (!page_add_zero (pg_round_down (addr), true))
+    return false;
+  stack_grows++;
+  return true;
+}
+
+/* Like page_load(), but also keeps the page resident until
+   page_unpin_all() is called. */
+bool
+page_pin (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+  bool success;
+
+  if (p == NULL)
+    return false;
+  lock_acquire (&p->lock);
+  success = load_locked (p, !p->pinned);
+  if (success && !p->pinned)
+    {
+      p->pinned = true;
+      list_push_back (&thread_current ()->pinned_pages, &p->pin_elem);
+    }
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Unpins every page the running process has pinned. */
+void
+page_unpin_all (void)
+{
+  struct list *pinned = &thread_current ()->pinned_pages;
+
+  while (!list_empty (pinned))
+    {
+      struct page *p = list_entry (list_pop_front (pinned),
+                                   struct page, pin_elem);
+      lock_acquire (&p->lock);
+      if (p->share != NULL)
+        share_unpin (p);
+      p->pinned = false;
+      lock_release (&p->lock);
+    }
+}
+
+/* Returns true if resident page P has been accessed since the
+   last call, clearing its accessed bit.  P's lock must be
+   held. */
+bool
+page_accessed (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame != NULL);
+
+  if (!pagedir_is_accessed (pd, p->upage))
+    return false;
+  pagedir_set_accessed (pd, p->upage, false);
+  return true;
+}
+
+/* Takes resident page P out of its owner's address space so
+   that its frame can be reused, writing it back to its file or
+   to swap first if its contents cannot be recovered otherwise.
+   P's lock must be held.  Returns true if successful, false if P
+   needs swap space and none is available, in which case P
+   remains resident. */
+bool
+page_evict (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame != NULL);
+
+  /* Unmap the page first, so that the owner cannot dirty it
+     after we look at the dirty bit. */
+  pagedir_clear_page (pd, p->upage);
+  if (pagedir_is_dirty (pd, p->upage) && p->kind == PAGE_MMAP)
+    write_back (p);
+  else if (pagedir_is_dirty (pd, p->upage))
+    {
+      p->swap_slot = swap_out (p->frame->kpage);
+      if (p->swap_slot == SWAP_NONE)
+        {
+          pagedir_set_page (pd, p->upage, p->frame->kpage, p->writable);
+          pagedir_set_dirty (pd, p->upage, true);
+          return false;
+        }
+    }
+  p->frame = NULL;
+  return true;
+}
+
+/* Prints demand paging, frame table, sharing and swap
+   statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld pages read from files, %lld zero-filled, "
+          "%lld written back to files, %lld stack pages added\n",
+          file_loads, zero_loads, file_writes, stack_grows);
+  frame_print_stats ();
+  share_print_stats ();
+  swap_print_stats ();
+}
+
+/* Makes P resident, if it is not already.  If P is shared and
+   PIN is true, also pins its shared copy.  P's lock must be
+   held.  Returns true if successful, false if memory is not
+   available. */
+static bool
+load_locked (struct page *p, bool pin)
+{
+  struct frame *f;
+  bool dirty = false;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  if (p->kind == PAGE_FILE && !p->writable)
+    return share_load (p, pin);
+  if (p->frame != NULL)
+    return true;
+
+  f = frame_alloc (p, p->swap_slot == SWAP_NONE && p->kind == PAGE_ZERO);
+  if (f == NULL)
+    return false;
+
+  if (p->swap_slot != SWAP_NONE)
+    {
+      /* Its only copy was in swap, so it must go back there if
+         it is evicted again. */
+      swap_in (p->swap_slot, f->kpage);
+      swap_free (p->swap_slot);
+      p->swap_slot = SWAP_NONE;
+      dirty = true;
+    }
+  else if (p->kind != PAGE_ZERO)
+    {
+      off_t n = file_read_at (p->file, f->kpage, p->read_bytes, p->ofs);
+      if (n != (off_t) p->read_bytes)
+        {
+          frame_free (f);
+          return false;
+        }
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+      file_loads++;
+    }
+  else
+    zero_loads++;
+
+  if (!pagedir_set_page (p->owner->pagedir, p->upage, f->kpage,
+                         p->writable))
+    {
+      frame_free (f);
+      return false;
+    }
+  pagedir_set_dirty (p->owner->pagedir, p->upage, dirty);
+  p->frame = f;
+  return true;
+}
+
+/* Writes resident page P, which must be PAGE_MMAP, back to its
+   file.  P's lock must be held. */
+static void
+write_back (struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->kind == PAGE_MMAP && p->frame != NULL);
+
+  file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+  file_writes++;
+}
+
+/* Returns a new page for UPAGE in the running process's address
+   space, not yet in its page table, or a null pointer if memory
+   is not available. */
+static struct page *
+page_create (void *upage, bool writable, enum page_kind kind)
+{
+  struct page *p = slab_alloc (&page_cache);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->owner = thread_current ();
+  p->writable = writable;
+  p->kind = kind;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  p->share = NULL;
+  p->frame = NULL;
+  p->swap_slot = SWAP_NONE;
+  p->pinned = false;
+  return p;
+}
+
+/* Inserts P into the running process's supplemental page table.
+   Returns true if successful; otherwise, frees P and returns
+   false. */
+static bool
+page_insert (struct page *p)
+{
+  if (hash_insert (&thread_current ()->pages, &p->elem) != NULL)
+    {
+      slab_free (&page_cache, p);
+      return false;
+    }
+  return true;
+}
+
+/* Constructs a struct page with an unheld lock. */
+static void
+page_ctor (void *p_)
+{
+  struct page *p = p_;
+  lock_init (&p->lock);
+}
+
+/* Returns a hash value for the page that E is in. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_int ((int) pg_no (p->upage));
+}
+
+/* Returns true if the page that A is in precedes the one B is
+   in. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  const struct page *pa = hash_entry (a, struct page, elem);
+  const struct page *pb = hash_entry (b, struct page, elem);
+  return pa->upage < pb->upage;
+}
+
+/* Frees the page that E is in, along with its frame or swap
+   slot, or its reference to a shared copy, first writing it back
+   to its file if it is a modified page of a mapped file.  Waits
+   for an eviction in progress to finish first. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, elem);
+
+  lock_acquire (&p->lock);
+  if (p->share != NULL)
+    share_detach (p);
+  if (p->frame != NULL)
+    {
+      uint32_t *pd = p->owner->pagedir;
+
+      pagedir_clear_page (pd, p->upage);
+      if (p->kind == PAGE_MMAP && pagedir_is_dirty (pd, p->upage))
+        write_back (p);
+      frame_free (p->frame);
+    }
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  lock_release (&p->lock);
+  slab_free (&page_cache, p);
+}
@@ -0,0 +1,76 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct file;
+struct thread;
+
+/* Where a page's contents come from when it is first touched. */
+enum page_kind
+  {
+    PAGE_FILE,                  /* Read from a file, zero the rest. */
+    PAGE_MMAP,                  /* Like PAGE_FILE, but written back. */
+    PAGE_ZERO                   /* All zeros. */
+  };
+
+/* A page of user virtual memory, in the supplemental page table
+   of the process that owns it.  A page is entered into the table
+   when the process's address space is laid out, but is given a
+   frame only when the process first touches it.  If it is later
+   evicted, it goes to swap, unless it can simply be read again
+   from its file or zeroed.  A read-only file page is instead
+   attached to a struct share, whose frame it maps in common with
+   every other process mapping the same page of the same file. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct thread *owner;       /* Owning process. */
+    bool writable;              /* Writable by the process? */
+    enum page_kind kind;        /* Source of initial contents. */
+    struct hash_elem elem;      /* Element in supplemental page table. */
+
+    /* For PAGE_FILE and PAGE_MMAP. */
+    struct file *file;          /* File to read. */
+    off_t ofs;                  /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read; the rest are zeroed. */
+    struct share *share;        /* Shared copy if read-only, or null. */
+    struct list_elem share_elem; /* Element in SHARE's mappings. */
+
+    /* Residence.  LOCK protects these members. */
+    struct lock lock;           /* Held while loading or evicting. */
+    struct frame *frame;        /* Frame holding the page, or null
+                                   if not resident or shared. */
+    size_t swap_slot;           /* Swap slot holding it, or SWAP_NONE. */
+    bool pinned;                /* Not to be evicted? */
+    struct list_elem pin_elem;  /* Element in owner's pinned list. */
+  };
+
+/* Maximum number of pages in a process's stack.
+   Controlled by kernel command-line option "-sl". */
+extern size_t page_stack_limit;
+
+void page_init (void);
+void page_table_init (void);
+void page_table_destroy (void);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes);
+bool page_add_zero (void *upage, bool writable);
+void page_remove (void *upage);
+struct page *page_lookup (const void *addr);
+bool page_load (const void *addr);
+bool page_grow_stack (const void *addr, const void *esp);
+bool page_pin (const void *addr);
+void page_unpin_all (void);
+bool page_accessed (struct page *);
+bool page_evict (struct page *);
+void page_print_stats (void);
+
+#endif /* vm/page.h */
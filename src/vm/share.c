@@ -0,0 +1,321 @@
+#include "vm/share.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Shared read-only pages.
+
+   Every process running a given program maps the same text
+   pages, which it cannot modify.  Rather than read a copy for
+   each process, the first process to touch such a page reads it
+   into a frame that belongs to a struct share, keyed by the
+   page's inode and offset, and later processes map that frame
+   read-only into their own page directories.  Starting a second
+   copy of a running program therefore reads none of its text
+   from disk.
+
+   A struct share lives as long as any page is attached to it.
+   Its frame is evicted like any other, except that the clock
+   looks at the accessed bits in all of its mappings, and
+   eviction unmaps it from every process at once.  Being
+   read-only, it is never written to swap.
+
+   SHARE_LOCK protects the table and each entry's REF_CNT.  An
+   entry's own lock nests inside the lock of an attached page and
+   outside the file system's locks; SHARE_LOCK is never held
+   while waiting for an entry's lock. */
+
+/* Shared pages, keyed by inode and offset. */
+static struct hash shares;
+static struct lock share_lock;
+
+/* Cache of struct share. */
+static struct slab_cache share_cache;
+
+/* Statistics. */
+static long long share_reads;   /* Shared pages read from files. */
+static long long share_hits;    /* Mappings made without reading. */
+
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static slab_ctor share_ctor;
+static struct share *share_get (struct inode *, off_t ofs,
+                                size_t read_bytes);
+static bool is_mapped (struct page *);
+
+/* Initializes the table of shared pages. */
+void
+share_init (void)
+{
+  if (!hash_init (&shares, share_hash, share_less, NULL))
+    PANIC ("out of memory for shared page table");
+  lock_init (&share_lock);
+  slab_cache_init (&share_cache, "share", sizeof (struct share),
+                   __alignof__ (struct share), share_ctor);
+}
+
+/* Maps read-only file page P, attaching it to the shared copy of
+   its contents first if it is not already attached, and reading
+   that copy in if no process has it resident.  If PIN is true,
+   also keeps the copy resident until share_unpin() is called on
+   P.  P's lock must be held.  Returns true if successful, false
+   if memory is not available or the file cannot be read. */
+bool
+share_load (struct page *p, bool pin)
+{
+  struct share *s;
+  bool success = false;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->kind == PAGE_FILE && !p->writable);
+
+  if (p->share == NULL)
+    {
+      p->share = share_get (file_get_inode (p->file), p->ofs,
+                            p->read_bytes);
+      if (p->share == NULL)
+        return false;
+    }
+  s = p->share;
+
+  lock_acquire (&s->lock);
+  if (s->frame == NULL)
+    {
+      struct frame *f;
+      off_t n;
+
+      f = frame_alloc_shared (s);
+      if (f == NULL)
+        goto done;
+      n = file_read_at (p->file, f->kpage, s->read_bytes, s->ofs);
+      if (n != (off_t) s->read_bytes)
+        {
+          frame_free (f);
+          goto done;
+        }
+      memset ((uint8_t *) f->kpage + s->read_bytes, 0,
+              PGSIZE - s->read_bytes);
+      s->frame = f;
+      share_reads++;
+    }
+  else if (!is_mapped (p))
+    share_hits++;
+
+  if (!is_mapped (p))
+    {
+      if (!pagedir_set_page (p->owner->pagedir, p->upage,
+                             s->frame->kpage, false))
+        goto done;
+      list_push_back (&s->pages, &p->share_elem);
+    }
+  if (pin)
+    s->pin_cnt++;
+  success = true;
+
+ done:
+  lock_release (&s->lock);
+  return success;
+}
+
+/* Undoes one share_load() call on P that pinned its shared copy.
+   P's lock must be held. */
+void
+share_unpin (struct page *p)
+{
+  struct share *s = p->share;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (s != NULL);
+
+  lock_acquire (&s->lock);
+  ASSERT (s->pin_cnt > 0);
+  s->pin_cnt--;
+  lock_release (&s->lock);
+}
+
+/* Unmaps P and detaches it from its shared copy, freeing the
+   copy if no other page is attached.  P's lock must be held. */
+void
+share_detach (struct page *p)
+{
+  struct share *s = p->share;
+  bool last;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (s != NULL);
+
+  lock_acquire (&s->lock);
+  if (p->pinned)
+    s->pin_cnt--;
+  if (is_mapped (p))
+    {
+      pagedir_clear_page (p->owner->pagedir, p->upage);
+      list_remove (&p->share_elem);
+    }
+  lock_release (&s->lock);
+  p->share = NULL;
+
+  lock_acquire (&share_lock);
+  last = --s->ref_cnt == 0;
+  if (last)
+    hash_delete (&shares, &s->elem);
+  lock_release (&share_lock);
+
+  if (last)
+    {
+      /* No one can find S now, but the frame table may be
+         evicting it; taking its lock waits for that to finish. */
+      lock_acquire (&s->lock);
+      ASSERT (list_empty (&s->pages));
+      if (s->frame != NULL)
+        {
+          frame_free (s->frame);
+          s->frame = NULL;
+        }
+      lock_release (&s->lock);
+      slab_free (&share_cache, s);
+    }
+}
+
+/* Returns true if resident shared page S has been accessed
+   through any of its mappings since the last call, clearing all
+   of their accessed bits.  S's lock must be held. */
+bool
+share_accessed (struct share *s)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  ASSERT (lock_held_by_current_thread (&s->lock));
+  ASSERT (s->frame != NULL);
+
+  for (e = list_begin (&s->pages); e != list_end (&s->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, share_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Unmaps resident shared page S from every process that maps it
+   so that its frame can be reused.  S's lock must be held.  S is
+   read-only, so its contents can always be read again later. */
+void
+share_evict (struct share *s)
+{
+  ASSERT (lock_held_by_current_thread (&s->lock));
+  ASSERT (s->frame != NULL);
+  ASSERT (s->pin_cnt == 0);
+
+  while (!list_empty (&s->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&s->pages),
+                                   struct page, share_elem);
+      pagedir_clear_page (p->owner->pagedir, p->upage);
+    }
+  s->frame = NULL;
+}
+
+/* Prints shared page statistics. */
+void
+share_print_stats (void)
+{
+  printf ("Sharing: %lld shared pages read, %lld mapped without reading, "
+          "%zu in use\n", share_reads, share_hits, hash_size (&shares));
+}
+
+/* Returns the shared copy of the READ_BYTES bytes at OFS in
+   INODE, creating it if there is none, with a reference added
+   for the caller.  Returns a null pointer if memory is not
+   available. */
+static struct share *
+share_get (struct inode *inode, off_t ofs, size_t read_bytes)
+{
+  struct share key, *s;
+  struct hash_elem *e;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&shares, &key.elem);
+  if (e != NULL)
+    s = hash_entry (e, struct share, elem);
+  else
+    {
+      s = slab_alloc (&share_cache);
+      if (s == NULL)
+        {
+          lock_release (&share_lock);
+          return NULL;
+        }
+      s->inode = inode;
+      s->ofs = ofs;
+      s->read_bytes = read_bytes;
+      s->ref_cnt = 0;
+      s->frame = NULL;
+      s->pin_cnt = 0;
+      hash_insert (&shares, &s->elem);
+    }
+  s->ref_cnt++;
+  lock_release (&share_lock);
+
+  return s;
+}
+
+/* Returns true if attached page P is mapped in its owner's page
+   directory.  The lock of P's shared copy must be held. */
+static bool
+is_mapped (struct page *p)
+{
+  return pagedir_get_page (p->owner->pagedir, p->upage) != NULL;
+}
+
+/* Constructs a struct share with an unheld lock and no pages. */
+static void
+share_ctor (void *s_)
+{
+  struct share *s = s_;
+  lock_init (&s->lock);
+  list_init (&s->pages);
+}
+
+/* Returns a hash value for the shared page that E is in. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct share *s = hash_entry (e, struct share, elem);
+  unsigned h = hash_bytes (&s->inode, sizeof s->inode);
+  return h ^ hash_int (s->ofs);
+}
+
+/* Returns true if the shared page that A is in precedes the one
+   B is in. */
+static bool
+share_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  const struct share *sa = hash_entry (a, struct share, elem);
+  const struct share *sb = hash_entry (b, struct share, elem);
+
+  if (sa->inode != sb->inode)
+    return sa->inode < sb->inode;
+  if (sa->ofs != sb->ofs)
+    return sa->ofs < sb->ofs;
+  return sa->read_bytes < sb->read_bytes;
+}
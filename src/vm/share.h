@@ -0,0 +1,40 @@
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct inode;
+struct page;
+
+/* A read-only page of an executable, shared by every process
+   that maps the same page of the same file.  One frame holds it
+   for all of them. */
+struct share
+  {
+    struct inode *inode;        /* File the page is read from. */
+    off_t ofs;                  /* Offset in file. */
+    size_t read_bytes;          /* Bytes read; the rest are zeroed. */
+    size_t ref_cnt;             /* Number of pages attached. */
+    struct hash_elem elem;      /* Element in table of shared pages. */
+
+    /* Residence.  LOCK protects these members. */
+    struct lock lock;           /* Held while loading or evicting. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list pages;          /* Attached pages mapping FRAME. */
+    size_t pin_cnt;             /* Number of attached pages pinned. */
+  };
+
+void share_init (void);
+bool share_load (struct page *, bool pin);
+void share_unpin (struct page *);
+void share_detach (struct page *);
+bool share_accessed (struct share *);
+void share_evict (struct share *);
+void share_print_stats (void);
+
+#endif /* vm/share.h */